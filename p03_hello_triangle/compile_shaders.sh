@@ -1,4 +1,46 @@
 export SHADERS_LOCATION=shaders
+export EMBEDDED_SHADERS_HEADER=$SHADERS_LOCATION/embedded_shaders.h
 
-glslc $SHADERS_LOCATION/shader.vert -o $SHADERS_LOCATION/vert.spv
-glslc $SHADERS_LOCATION/shader.frag -o $SHADERS_LOCATION/frag.spv
+# "./compile_shaders.sh embed" only regenerates the header from the .spv files
+if [ "$1" != "embed" ]; then
+  glslc $SHADERS_LOCATION/shader.vert -o $SHADERS_LOCATION/vert.spv
+  glslc $SHADERS_LOCATION/shader.frag -o $SHADERS_LOCATION/frag.spv
+fi
+
+# turns the compiled shaders into constexpr word arrays, registered under
+# the same relative path main.cpp would otherwise open
+embed_spirv() {
+  name=$(basename "$1" .spv)
+
+  echo "constexpr uint32_t EMBEDDED_SHADER_$name[] = {"
+  od -An -v -tx4 "$1" | sed -E 's/ +([0-9a-f]{8})/ 0x\1,/g'
+  echo "};"
+  echo
+}
+
+{
+  echo "// generated by compile_shaders.sh, do not edit"
+  echo "#pragma once"
+  echo
+  echo "#include <cstddef>"
+  echo "#include <cstdint>"
+  echo "#include <string_view>"
+  echo
+
+  for spirv in $SHADERS_LOCATION/*.spv; do
+    embed_spirv "$spirv"
+  done
+
+  echo "struct EmbeddedShader {"
+  echo "  std::string_view name;"
+  echo "  const uint32_t* words;"
+  echo "  size_t size;"
+  echo "};"
+  echo
+  echo "constexpr EmbeddedShader EMBEDDED_SHADERS[] = {"
+  for spirv in $SHADERS_LOCATION/*.spv; do
+    name=$(basename "$spirv" .spv)
+    echo "  {\"$spirv\", EMBEDDED_SHADER_$name, sizeof(EMBEDDED_SHADER_$name)},"
+  done
+  echo "};"
+} > $EMBEDDED_SHADERS_HEADER
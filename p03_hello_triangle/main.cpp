@@ -4,21 +4,142 @@
 #include <memory>
 #include <vector>
 #include <cstring>
+#include <cstdio>
 #include <optional>
 #include <set>
 #include <fstream>
+#include <sstream>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <deque>
+#include <chrono>
+#include <map>
+#include <array>
+#include <bit>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <filesystem>
+#include <cerrno>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#define HAS_MMAP
+#define HAS_SPAWN
+extern char** environ;
+#endif
+
+// runtime GLSL compilation, built with "make SHADERC=1"
+#ifdef HAS_SHADERC
+#include <shaderc/shaderc.hpp>
+// the shaderc release linked against, set by the Makefile
+#ifndef SHADERC_VERSION
+#define SHADERC_VERSION ""
+#endif
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#define HAS_INOTIFY
+#endif
 
 #define GLFW_INCLUDE_VULKAN
 #include "GLFW/glfw3.h"
 
+// generated by compile_shaders.sh, "make" builds it before main.cpp; a
+// missing header fails the build instead of quietly loading from disk
+#include "shaders/embedded_shaders.h"
+
+// the GLSL sources in shaders/ hot reload recompiles, and the SPIR-V
+// compile_shaders.sh builds from each
+const std::map<std::string, std::string> hotReloadShaders = {
+  {"shader.vert", "vert.spv"},
+  {"shader.frag", "frag.spv"}
+};
+
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
 
-const std::vector<const char*> deviceExtensions = {
+const std::vector<const char*> swapChainDeviceExtensions = {
   VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+const std::vector<const char*> shaderObjectDeviceExtensions = {
+  VK_EXT_SHADER_OBJECT_EXTENSION_NAME
+};
+
+const std::vector<const char*> pipelineLibraryDeviceExtensions = {
+  VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+  VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME
+};
+
+const std::vector<const char*> presentWaitDeviceExtensions = {
+  VK_KHR_PRESENT_ID_EXTENSION_NAME,
+  VK_KHR_PRESENT_WAIT_EXTENSION_NAME
+};
+
+// device commands on the per-frame path, called through the pointers
+// vkGetDeviceProcAddr returns for the device instead of the loader's
+// exports, which would go through its dispatch trampoline on every call
+#define DEVICE_DISPATCH_FUNCTIONS(X) \
+  X(vkAcquireNextImageKHR) \
+  X(vkBeginCommandBuffer) \
+  X(vkCmdBeginRenderPass) \
+  X(vkCmdBeginRendering) \
+  X(vkCmdBindPipeline) \
+  X(vkCmdCopyImageToBuffer) \
+  X(vkCmdDraw) \
+  X(vkCmdEndRenderPass) \
+  X(vkCmdEndRendering) \
+  X(vkCmdPipelineBarrier) \
+  X(vkCmdSetCullMode) \
+  X(vkCmdSetDepthBiasEnable) \
+  X(vkCmdSetDepthBoundsTestEnable) \
+  X(vkCmdSetDepthCompareOp) \
+  X(vkCmdSetDepthTestEnable) \
+  X(vkCmdSetDepthWriteEnable) \
+  X(vkCmdSetFrontFace) \
+  X(vkCmdSetLineWidth) \
+  X(vkCmdSetPrimitiveRestartEnable) \
+  X(vkCmdSetPrimitiveTopology) \
+  X(vkCmdSetRasterizerDiscardEnable) \
+  X(vkCmdSetScissor) \
+  X(vkCmdSetScissorWithCount) \
+  X(vkCmdSetStencilTestEnable) \
+  X(vkCmdSetViewport) \
+  X(vkCmdSetViewportWithCount) \
+  X(vkEndCommandBuffer) \
+  X(vkGetFenceStatus) \
+  X(vkGetSemaphoreCounterValue) \
+  X(vkQueuePresentKHR) \
+  X(vkQueueSubmit) \
+  X(vkResetCommandBuffer) \
+  X(vkResetFences) \
+  X(vkWaitForFences) \
+  X(vkWaitForPresentKHR) \
+  X(vkWaitSemaphores)
+
+// null where the device's version or extensions lack a command, the same
+// checks that enable the features using it
+struct DeviceDispatch {
+#define DEVICE_DISPATCH_MEMBER(name) PFN_##name name = nullptr;
+  DEVICE_DISPATCH_FUNCTIONS(DEVICE_DISPATCH_MEMBER)
+#undef DEVICE_DISPATCH_MEMBER
+};
+
 #define NDEBUG
 
 #ifdef NDEBUG
@@ -60,808 +181,5274 @@ void DestroyDebugUtilsMessengerEXT(
     }
 }
 
-static std::vector<char> readFile(const std::string& filename) {
+const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// a read-only SPIR-V file, mapped so it goes to the driver without a copy;
+// where there is no mmap the words are read into an aligned buffer instead
+class SpirvBlob {
+public:
+  // borrows words that outlive the blob, such as the embedded shaders
+  SpirvBlob(const uint32_t* words, size_t size) : m_words(words), m_size(size) {}
+
+  // owns words compiled at runtime
+  explicit SpirvBlob(std::vector<uint32_t> words)
+    : m_buffer(std::move(words)),
+      m_words(m_buffer.data()),
+      m_size(m_buffer.size() * sizeof(uint32_t)) {}
+
+  explicit SpirvBlob(const std::string& filename) {
+#ifdef HAS_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("ERROR_OPEN_FILE - " + filename);
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+      close(fd);
+      throw std::runtime_error("ERROR_OPEN_FILE - " + filename);
+    }
+    m_size = static_cast<size_t>(fileStat.st_size);
+
+    if (m_size > 0) {
+      void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("ERROR_MAP_FILE - " + filename);
+      }
+      m_mapping = mapping;
+      m_words = static_cast<const uint32_t*>(mapping);
+    }
+
+    // the mapping stays valid after the descriptor is gone
+    close(fd);
+#else
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
-        throw std::runtime_error("ERROR_OPEN_FILE - " + filename);
+      throw std::runtime_error("ERROR_OPEN_FILE - " + filename);
     }
 
-    size_t fileSize = file.tellg();
-    std::vector<char> buffer(fileSize);
+    m_size = file.tellg();
+    m_buffer.resize((m_size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
 
     file.seekg(0);
-    file.read(buffer.data(), fileSize);
-    file.close();
+    file.read(reinterpret_cast<char*>(m_buffer.data()), m_size);
+    m_words = m_buffer.data();
+#endif
 
-    return buffer;
-}
+    // page aligned when mapped, so only the size and header are left to check
+    if (m_size < 5 * sizeof(uint32_t) || m_size % sizeof(uint32_t) != 0) {
+      release();
+      throw std::runtime_error("ERROR_INVALID_SPIRV_SIZE - " + filename);
+    }
 
-struct QueueFamilyIndices {
-  std::optional<uint32_t> graphicsFamily;
-  std::optional<uint32_t> presentationFamily;
+    if (m_words[0] != SPIRV_MAGIC) {
+      release();
+      throw std::runtime_error("ERROR_INVALID_SPIRV_MAGIC - " + filename);
+    }
+  }
 
-  bool isComplete() {
-    return graphicsFamily.has_value() && presentationFamily.has_value();
+  ~SpirvBlob() {
+    release();
   }
-};
 
-struct SwapChainSupportDetails {
-    VkSurfaceCapabilitiesKHR capabilities;
-    std::vector<VkSurfaceFormatKHR> formats;
-    std::vector<VkPresentModeKHR> presentModes;
-};
+  SpirvBlob(const SpirvBlob&) = delete;
+  SpirvBlob& operator=(const SpirvBlob&) = delete;
 
-class HelloTriangleApp {
+  const uint32_t* words() const {
+    return m_words;
+  }
+
+  // in bytes, as vkCreateShaderModule wants it
+  size_t size() const {
+    return m_size;
+  }
 
 private:
-  GLFWwindow * m_window;
-  uint32_t m_windowWidth = 100;
-  uint32_t m_windowHeight = 100;
+  void release() {
+#ifdef HAS_MMAP
+    if (m_mapping != nullptr) {
+      munmap(m_mapping, m_size);
+      m_mapping = nullptr;
+    }
+#endif
+    m_words = nullptr;
+  }
 
-  VkInstance m_vkInstance;
+#ifdef HAS_MMAP
+  void* m_mapping = nullptr;
+#endif
+  std::vector<uint32_t> m_buffer;
+  const uint32_t* m_words = nullptr;
+  size_t m_size = 0;
+};
 
-  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
-  VkDevice m_logicalDevice;
+constexpr const EmbeddedShader* findEmbeddedShader(std::string_view name) {
+  for (const EmbeddedShader& shader : EMBEDDED_SHADERS) {
+    if (shader.name == name) {
+      return &shader;
+    }
+  }
 
-  VkSurfaceKHR m_vkSurface;
+  return nullptr;
+}
 
-  VkSwapchainKHR m_vkSwapChain;
-  std::vector<VkImage> m_swapChainImages;
-  VkFormat m_swapChainImageFormat;
-  VkExtent2D m_swapChainExtent;
-  std::vector<VkImageView> m_swapChainImageViews;
-  std::vector<VkFramebuffer> m_swapChainFramebuffers;
+static_assert(findEmbeddedShader("shaders/vert.spv")->words[0] == SPIRV_MAGIC);
+static_assert(findEmbeddedShader("shaders/frag.spv")->words[0] == SPIRV_MAGIC);
 
-  VkQueue m_graphicsQueue;
-  VkQueue m_presentationQueue;
+// built-in shaders come out of the executable, anything else from disk;
+// preferDisk picks up shaders recompiled since the build
+static SpirvBlob loadSpirv(const std::string& name, bool preferDisk = false) {
+  if (!preferDisk) {
+    if (const EmbeddedShader* shader = findEmbeddedShader(name)) {
+      return SpirvBlob(shader->words, shader->size);
+    }
+  }
 
-  VkPipeline m_graphicsPipeline;
-  VkRenderPass m_renderPass;
-  VkPipelineLayout m_pipelineLayout;
+  return SpirvBlob(name);
+}
 
-  VkCommandPool m_commandPool;
-  VkCommandBuffer m_commandBuffer;
+// FNV-1a, continued from hash so several inputs chain into one value
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
 
-  VkSemaphore m_imageAvailableSemaphore;
-  VkSemaphore m_renderFinishedSemaphore;
-  VkFence m_inFlightFence;
+// runs a program from the PATH with exactly these arguments, no shell in
+// between to interpret them; true when it exits with status 0
+static bool runProgram(const std::vector<std::string>& args) {
+#ifdef HAS_SPAWN
+  std::vector<char*> argv;
+  for (const std::string& arg : args) {
+    argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
 
-  VkDebugUtilsMessengerEXT m_debugMessenger;
+  pid_t pid;
+  if (posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ) != 0) {
+    return false;
+  }
 
-public:
+  int status = 0;
+  while (waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR) {
+      return false;
+    }
+  }
 
-  HelloTriangleApp(
-    const int windowWidth = 640,
-    const int windowHeight = 480
-  ) {
-    m_windowWidth = windowWidth;
-    m_windowHeight = windowHeight;
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#else
+  (void) args;
+  return false;
+#endif
+}
+
+static std::string readText(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+
+  if (!file.is_open()) {
+    throw std::runtime_error("ERROR_OPEN_FILE - " + filename);
   }
 
-  void run() {
-    initWindow();
-    initVulkan();
-    mainLoop();
-    cleanup();
+  std::stringstream text;
+  text << file.rdbuf();
+  return text.str();
+}
+
+// compiles GLSL in-process; the SPIR-V is cached in memory and on disk
+// under a hash of the source, its includes, the compile options and the
+// compiler version, so only edited shaders are ever compiled again
+class ShaderCompiler {
+
+public:
+  ShaderCompiler(
+    std::string cacheDir,
+    std::vector<std::pair<std::string, std::string>> defines
+  ) : m_cacheDir(std::move(cacheDir)), m_defines(std::move(defines)) {
+    if (!m_cacheDir.empty()) {
+      std::error_code error;
+      std::filesystem::create_directories(m_cacheDir, error);
+    }
   }
 
+  static bool isAvailable() {
+#ifdef HAS_SHADERC
+    return true;
+#else
+    return false;
+#endif
+  }
 
-private:
+  // safe to call from several threads, cold compiles run concurrently
+  std::vector<uint32_t> compile(const std::string& path) {
+    auto startTime = std::chrono::steady_clock::now();
 
-  void initWindow() {
-    glfwInit();
+    std::string source = readText(path);
+    uint64_t key = cacheKey(path, source);
 
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto cached = m_compiled.find(key);
+      if (cached != m_compiled.end()) {
+        return cached->second;
+      }
+    }
 
-    m_window = glfwCreateWindow(
-      m_windowWidth, m_windowHeight, "Hello Triangle", nullptr, nullptr
+    const char* origin = "cache";
+    std::vector<uint32_t> words = readCacheFile(key);
+    if (words.empty()) {
+      origin = "compiled";
+      words = compileGlsl(path, source);
+      writeCacheFile(key, words);
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = (
+      std::chrono::steady_clock::now() - startTime
     );
+    std::cout << "SHADER_COMPILER: " << path << " " << origin
+      << " in " << elapsed.count() << " ms" << '\n';
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_compiled.emplace(key, std::move(words)).first->second;
   }
 
-  void setupDebugMessenger() {
-      if (!enableValidationLayers) return;
+  // warms the cache for all paths at once instead of one after another
+  void prewarm(const std::vector<std::string>& paths) {
+    std::vector<std::future<std::vector<uint32_t>>> compiles;
+    for (const std::string& path : paths) {
+      compiles.push_back(std::async(std::launch::async, [this, path]() {
+        return compile(path);
+      }));
+    }
 
-      VkDebugUtilsMessengerCreateInfoEXT createInfo;
-      populateDebugMessengerCreateInfo(createInfo);
+    // rethrows the first compile error
+    for (auto& compiled : compiles) {
+      compiled.get();
+    }
+  }
 
-      VkResult result = CreateDebugUtilsMessengerEXT(
-        m_vkInstance, &createInfo, nullptr, &m_debugMessenger
-      );
+private:
+  uint64_t cacheKey(const std::string& path, const std::string& source) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = fnv1a(hash, path.data(), path.size());
+    hash = fnv1a(hash, source.data(), source.size());
 
-      if (result != VK_SUCCESS) {
-          throw std::runtime_error("ERROR_FAILED_SETUP_DEBUG_MESSENGER");
-      }
-  }
+    std::set<std::string> visited;
+    hash = hashIncludes(hash, path, source, visited);
 
-  void createVkInstance() {
-    std::cout << "CREATE_VK_INSTANCE" << '\n';
+    for (const auto& [name, value] : m_defines) {
+      hash = fnv1a(hash, name.data(), name.size() + 1);
+      hash = fnv1a(hash, value.data(), value.size() + 1);
+    }
 
-    if (enableValidationLayers && !checkValidationLayerSupport()) {
-        throw std::runtime_error("validation layers requested, but not available!");
+#ifdef HAS_SHADERC
+    // shaderc cannot report its own version at runtime, the Makefile bakes
+    // in the one it built against; without it every build gets a fresh
+    // cache rather than trusting SPIR-V from an unknown compiler
+    std::string compilerVersion = SHADERC_VERSION;
+    if (compilerVersion.empty()) {
+      compilerVersion = __DATE__ " " __TIME__;
     }
+    hash = fnv1a(hash, compilerVersion.data(), compilerVersion.size() + 1);
+
+    unsigned int version = 0;
+    unsigned int revision = 0;
+    shaderc_get_spv_version(&version, &revision);
+    hash = fnv1a(hash, &version, sizeof(version));
+    hash = fnv1a(hash, &revision, sizeof(revision));
+
+    uint32_t options[] = {
+      static_cast<uint32_t>(TARGET_ENV),
+      TARGET_ENV_VERSION,
+      static_cast<uint32_t>(OPTIMIZATION_LEVEL)
+    };
+    hash = fnv1a(hash, options, sizeof(options));
+#endif
 
-    // declare necessary structures
-    VkApplicationInfo appInfo{};
-    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
-    appInfo.pApplicationName = "Hello Triangle";
-    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.pEngineName = "No Engine";
-    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_3;
+    return hash;
+  }
 
-    VkInstanceCreateInfo createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
-    createInfo.pApplicationInfo = &appInfo;
+  // follows #include lines textually, which is enough to notice an
+  // edited header without running the preprocessor
+  uint64_t hashIncludes(
+    uint64_t hash,
+    const std::string& path,
+    const std::string& source,
+    std::set<std::string>& visited
+  ) {
+    std::string directory = std::filesystem::path(path).parent_path().string();
+
+    std::istringstream lines(source);
+    std::string line;
+    while (std::getline(lines, line)) {
+      size_t directive = line.find("#include");
+      if (directive == std::string::npos) {
+        continue;
+      }
 
-    // obtain GLFW extensions
-    auto extensions = getRequiredExtensions();
+      size_t begin = line.find_first_of("\"<", directive);
+      size_t end = line.find_first_of("\">", begin + 1);
+      if (begin == std::string::npos || end == std::string::npos) {
+        continue;
+      }
 
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-    createInfo.ppEnabledExtensionNames = extensions.data();
+      std::string include = (
+        std::filesystem::path(directory) / line.substr(begin + 1, end - begin - 1)
+      ).string();
+      if (!visited.insert(include).second) {
+        continue;
+      }
 
-    // debugging
-    VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
-    if (enableValidationLayers) {
-        createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
-        createInfo.ppEnabledLayerNames = validationLayers.data();
+      std::string content;
+      try {
+        content = readText(include);
+      } catch (const std::exception&) {
+        // left for the compiler to report
+      }
 
-        populateDebugMessengerCreateInfo(debugCreateInfo);
-        createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugCreateInfo;
-    } else {
-        createInfo.enabledLayerCount = 0;
-        createInfo.pNext = nullptr;
+      hash = fnv1a(hash, include.data(), include.size());
+      hash = fnv1a(hash, content.data(), content.size());
+      hash = hashIncludes(hash, include, content, visited);
     }
 
-    // display some info about VK extensions
-    uint32_t extPropertyCount = 0;
-    vkEnumerateInstanceExtensionProperties(
-      nullptr,
-      &extPropertyCount,
-      nullptr
-    );
+    return hash;
+  }
 
-    std::vector<VkExtensionProperties> extProperties(extPropertyCount);
-    vkEnumerateInstanceExtensionProperties(
-      nullptr,
-      &extPropertyCount,
-      extProperties.data()
-    );
+  std::string cacheFilePath(uint64_t key) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long) key);
+    return m_cacheDir + "/" + name;
+  }
 
-    std::cout << "VK_EXT_PROP_COUNT: " << extPropertyCount << '\n';
+  // empty on a miss or an unreadable entry
+  std::vector<uint32_t> readCacheFile(uint64_t key) {
+    if (m_cacheDir.empty()) {
+      return {};
+    }
 
-    std::cout << "EXT_PROP_VECTOR_SIZE: " << extProperties.size() << '\n';;
-    for (const auto& ext : extProperties) {
-      std::cout << '\t' << ext.extensionName << std::endl;
+    std::ifstream file(cacheFilePath(key), std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+      return {};
     }
 
-    // proceed with creating the VK instance
-    VkResult result = vkCreateInstance(&createInfo, nullptr, &m_vkInstance);
-    if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAILED_TO_CREATE_VK_INSTANCE");
+    size_t fileSize = file.tellg();
+    if (fileSize == 0 || fileSize % sizeof(uint32_t) != 0) {
+      return {};
     }
-  }
 
-  void createSurface() {
-    VkResult result = glfwCreateWindowSurface(
-      m_vkInstance, m_window, nullptr, &m_vkSurface
-    );
+    std::vector<uint32_t> words(fileSize / sizeof(uint32_t));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(words.data()), fileSize);
 
-    if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAILED_CREATE_WINDOW_SURFACE");
+    if (!file || words[0] != SPIRV_MAGIC) {
+      return {};
     }
-  }
 
-  void pickPhysicalDevice() {
-    // count the devices
-    uint32_t deviceCount = 0;
-    vkEnumeratePhysicalDevices(m_vkInstance, &deviceCount, nullptr);
+    return words;
+  }
 
-    // no devices handling
-    if (deviceCount == 0) {
-      throw std::runtime_error("ERROR_NO_PHYSICAL_DEVICES_AVAILABLE");
+  // the rename keeps concurrent readers from seeing half an entry
+  void writeCacheFile(uint64_t key, const std::vector<uint32_t>& words) {
+    if (m_cacheDir.empty()) {
+      return;
     }
 
-    // get all devices
-    std::vector<VkPhysicalDevice> devices(deviceCount);
-    vkEnumeratePhysicalDevices(m_vkInstance, &deviceCount, devices.data());
+    std::string path = cacheFilePath(key);
+    std::string tempPath = path + ".tmp" + std::to_string(
+      std::hash<std::thread::id>{}(std::this_thread::get_id())
+    );
+    {
+      std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+      file.write(
+        reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint32_t)
+      );
 
-    // select the first suitable device
-    for (const auto& device: devices) {
-      if (isDeviceSuitable(device)) {
-        m_physicalDevice = device;
-        break;
+      if (!file) {
+        std::cerr << "SHADER_COMPILER: failed to write " << tempPath << '\n';
+        return;
       }
     }
 
-    // no device could be used
-    if (m_physicalDevice == VK_NULL_HANDLE) {
-      throw std::runtime_error("ERROR_NO_PHYISICAL_DEVICE_SUITABLE");
-    }
+    std::rename(tempPath.c_str(), path.c_str());
   }
 
-  void createLogicalDevice() {
-
-    // define create info for the device queues
-    QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+#ifdef HAS_SHADERC
+  // resolves #include "file" next to the including file
+  class Includer : public shaderc::CompileOptions::IncluderInterface {
+  public:
+    shaderc_include_result* GetInclude(
+      const char* requestedSource,
+      shaderc_include_type type,
+      const char* requestingSource,
+      size_t includeDepth
+    ) override {
+      (void) type;
+      (void) includeDepth;
+
+      auto* include = new IncludeData();
+      include->name = (
+        std::filesystem::path(requestingSource).parent_path() / requestedSource
+      ).string();
+
+      try {
+        include->content = readText(include->name);
+      } catch (const std::exception&) {
+        // an empty name tells shaderc the include failed
+        include->content = "cannot open " + include->name;
+        include->name.clear();
+      }
 
-    std::vector<VkDeviceQueueCreateInfo> devQueueCreateInfoVector;
-    std::set<uint32_t> uniqueQueueFamilies = {
-      indices.graphicsFamily.value(),
-      indices.presentationFamily.value()
-    };
+      include->result.source_name = include->name.data();
+      include->result.source_name_length = include->name.size();
+      include->result.content = include->content.data();
+      include->result.content_length = include->content.size();
+      include->result.user_data = include;
+      return &include->result;
+    }
 
-    float queuePriority = 1.0f;
+    void ReleaseInclude(shaderc_include_result* result) override {
+      delete static_cast<IncludeData*>(result->user_data);
+    }
 
-    for (const uint32_t queueFamily : uniqueQueueFamilies) {
-      VkDeviceQueueCreateInfo devQueueCreateInfo{};
-      devQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-      devQueueCreateInfo.queueFamilyIndex = queueFamily;
-      devQueueCreateInfo.queueCount = 1;
-      devQueueCreateInfo.pQueuePriorities = &queuePriority;
+  private:
+    struct IncludeData {
+      std::string name;
+      std::string content;
+      shaderc_include_result result;
+    };
+  };
+#endif
 
-      devQueueCreateInfoVector.push_back(devQueueCreateInfo);
+  std::vector<uint32_t> compileGlsl(const std::string& path, const std::string& source) {
+#ifdef HAS_SHADERC
+    shaderc_shader_kind kind;
+    if (path.ends_with(".vert")) {
+      kind = shaderc_vertex_shader;
+    } else if (path.ends_with(".frag")) {
+      kind = shaderc_fragment_shader;
+    } else {
+      throw std::runtime_error("ERROR_UNKNOWN_SHADER_STAGE - " + path);
     }
 
-    // phyisical device features
-    VkPhysicalDeviceFeatures physicalDevFeatures{};
-
-    // define create info for the logical device
-    VkDeviceCreateInfo devCreateInfo{};
-    devCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    shaderc::CompileOptions options;
+    options.SetTargetEnvironment(TARGET_ENV, TARGET_ENV_VERSION);
+    options.SetOptimizationLevel(OPTIMIZATION_LEVEL);
+    options.SetIncluder(std::make_unique<Includer>());
+    for (const auto& [name, value] : m_defines) {
+      options.AddMacroDefinition(name, value);
+    }
 
-    devCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(
-      devQueueCreateInfoVector.size()
+    shaderc::SpvCompilationResult result = m_compiler.CompileGlslToSpv(
+      source, kind, path.c_str(), options
     );
-    devCreateInfo.pQueueCreateInfos = devQueueCreateInfoVector.data();
-
-    devCreateInfo.pEnabledFeatures = &physicalDevFeatures;
 
+    if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+      throw std::runtime_error(
+        "ERROR_FAIL_COMPILE_SHADER - " + path + "\n" + result.GetErrorMessage()
+      );
+    }
+
+    return std::vector<uint32_t>(result.cbegin(), result.cend());
+#else
+    (void) source;
+    throw std::runtime_error("ERROR_NO_SHADER_COMPILER - " + path);
+#endif
+  }
+
+  std::string m_cacheDir;
+  std::vector<std::pair<std::string, std::string>> m_defines;
+#ifdef HAS_SHADERC
+  // every option compileGlsl() sets besides the defines, part of the key
+  static constexpr shaderc_target_env TARGET_ENV = shaderc_target_env_vulkan;
+  static constexpr uint32_t TARGET_ENV_VERSION = shaderc_env_version_vulkan_1_3;
+  static constexpr shaderc_optimization_level OPTIMIZATION_LEVEL = (
+    shaderc_optimization_level_performance
+  );
+
+  // compiling through one compiler is thread safe
+  shaderc::Compiler m_compiler;
+#endif
+  std::mutex m_mutex;
+  std::unordered_map<uint64_t, std::vector<uint32_t>> m_compiled;
+};
+
+// what a shader needs from its pipeline layout and vertex input, read
+// from its SPIR-V instead of kept in sync by hand
+struct ShaderReflection {
+  VkShaderStageFlags stage = 0;
+  // set number to its bindings, sorted by binding
+  std::map<uint32_t, std::vector<VkDescriptorSetLayoutBinding>> descriptorSets;
+  // bytes of the push constant block and the stages declaring it
+  uint32_t pushConstantSize = 0;
+  VkShaderStageFlags pushConstantStages = 0;
+  // vertex shader inputs by location, tightly packed into binding 0
+  std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+  uint32_t vertexStride = 0;
+  // the layout(constant_id = N) ids the shader declares
+  std::set<uint32_t> specConstantIds;
+};
+
+// the subset of SPIR-V types reflection needs to size and classify
+struct SpirvType {
+  uint32_t opcode = 0;
+  std::vector<uint32_t> operands;
+};
+
+static ShaderReflection reflectSpirv(const SpirvBlob& code) {
+  // opcodes, storage classes and decorations from the SPIR-V spec
+  enum : uint32_t {
+    OP_ENTRY_POINT = 15, OP_TYPE_INT = 21, OP_TYPE_FLOAT = 22,
+    OP_TYPE_VECTOR = 23, OP_TYPE_MATRIX = 24, OP_TYPE_IMAGE = 25,
+    OP_TYPE_SAMPLER = 26, OP_TYPE_SAMPLED_IMAGE = 27, OP_TYPE_ARRAY = 28,
+    OP_TYPE_RUNTIME_ARRAY = 29, OP_TYPE_STRUCT = 30, OP_TYPE_POINTER = 32,
+    OP_CONSTANT = 43, OP_SPEC_CONSTANT_TRUE = 48, OP_SPEC_CONSTANT_FALSE = 49,
+    OP_SPEC_CONSTANT = 50, OP_VARIABLE = 59, OP_DECORATE = 71, OP_MEMBER_DECORATE = 72
+  };
+  enum : uint32_t {
+    STORAGE_UNIFORM_CONSTANT = 0, STORAGE_INPUT = 1, STORAGE_UNIFORM = 2,
+    STORAGE_PUSH_CONSTANT = 9, STORAGE_STORAGE_BUFFER = 12
+  };
+  enum : uint32_t {
+    DECORATION_SPEC_ID = 1, DECORATION_BLOCK = 2, DECORATION_BUFFER_BLOCK = 3,
+    DECORATION_ARRAY_STRIDE = 6, DECORATION_MATRIX_STRIDE = 7, DECORATION_BUILT_IN = 11,
+    DECORATION_LOCATION = 30, DECORATION_BINDING = 33, DECORATION_DESCRIPTOR_SET = 34,
+    DECORATION_OFFSET = 35
+  };
+  enum : uint32_t { EXECUTION_MODEL_VERTEX = 0, EXECUTION_MODEL_FRAGMENT = 4 };
+  enum : uint32_t { DIM_BUFFER = 5, DIM_SUBPASS_DATA = 6 };
+
+  struct Variable {
+    uint32_t pointerType;
+    uint32_t storageClass;
+  };
+
+  std::unordered_map<uint32_t, SpirvType> types;
+  std::unordered_map<uint32_t, uint32_t> constants;
+  std::unordered_map<uint32_t, Variable> variables;
+  std::unordered_map<uint32_t, std::map<uint32_t, uint32_t>> decorations;
+  std::unordered_map<uint32_t, std::map<uint32_t, std::map<uint32_t, uint32_t>>> memberDecorations;
+
+  ShaderReflection reflection;
+
+  const uint32_t* words = code.words();
+  size_t wordCount = code.size() / sizeof(uint32_t);
+
+  // past the five word header every instruction starts with its length
+  // and opcode packed into one word
+  for (size_t offset = 5; offset < wordCount;) {
+    uint32_t length = words[offset] >> 16;
+    uint32_t opcode = words[offset] & 0xffff;
+
+    if (length == 0 || offset + length > wordCount) {
+      throw std::runtime_error("ERROR_INVALID_SPIRV_INSTRUCTION");
+    }
+
+    const uint32_t* operands = words + offset + 1;
+    uint32_t operandCount = length - 1;
+
+    switch (opcode) {
+      case OP_ENTRY_POINT:
+        if (operands[0] == EXECUTION_MODEL_VERTEX) {
+          reflection.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        } else if (operands[0] == EXECUTION_MODEL_FRAGMENT) {
+          reflection.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+        break;
+      case OP_TYPE_INT:
+      case OP_TYPE_FLOAT:
+      case OP_TYPE_VECTOR:
+      case OP_TYPE_MATRIX:
+      case OP_TYPE_IMAGE:
+      case OP_TYPE_SAMPLER:
+      case OP_TYPE_SAMPLED_IMAGE:
+      case OP_TYPE_ARRAY:
+      case OP_TYPE_RUNTIME_ARRAY:
+      case OP_TYPE_STRUCT:
+      case OP_TYPE_POINTER:
+        types[operands[0]] = {opcode, std::vector<uint32_t>(operands + 1, operands + operandCount)};
+        break;
+      case OP_CONSTANT:
+        constants[operands[1]] = operands[2];
+        break;
+      // array lengths may be specialization constants, which are taken
+      // at their defaults; the specialized value is not known here
+      case OP_SPEC_CONSTANT:
+        constants[operands[1]] = operands[2];
+        break;
+      case OP_SPEC_CONSTANT_TRUE:
+      case OP_SPEC_CONSTANT_FALSE:
+        constants[operands[1]] = opcode == OP_SPEC_CONSTANT_TRUE;
+        break;
+      case OP_VARIABLE:
+        variables[operands[1]] = {operands[0], operands[2]};
+        break;
+      case OP_DECORATE:
+        decorations[operands[0]][operands[1]] = operandCount > 2 ? operands[2] : 0;
+        break;
+      case OP_MEMBER_DECORATE:
+        memberDecorations[operands[0]][operands[1]][operands[2]] = (
+          operandCount > 3 ? operands[3] : 0
+        );
+        break;
+      default:
+        break;
+    }
+
+    offset += length;
+  }
+
+  auto hasDecoration = [&decorations](uint32_t id, uint32_t decoration) {
+    auto found = decorations.find(id);
+    return found != decorations.end() && found->second.count(decoration) > 0;
+  };
+
+  // byte size under the explicit layout decorations, which every block
+  // in the interface between Vulkan and a shader carries
+  std::function<uint32_t(uint32_t)> typeSize = [&](uint32_t typeId) -> uint32_t {
+    const SpirvType& type = types.at(typeId);
+    switch (type.opcode) {
+      case OP_TYPE_INT:
+      case OP_TYPE_FLOAT:
+        return type.operands[0] / 8;
+      case OP_TYPE_VECTOR:
+        return typeSize(type.operands[0]) * type.operands[1];
+      case OP_TYPE_MATRIX:
+        return typeSize(type.operands[0]) * type.operands[1];
+      case OP_TYPE_ARRAY:
+        return decorations[typeId][DECORATION_ARRAY_STRIDE] * constants[type.operands[1]];
+      case OP_TYPE_STRUCT: {
+        uint32_t size = 0;
+        for (uint32_t member = 0; member < type.operands.size(); ++member) {
+          auto& memberDecoration = memberDecorations[typeId][member];
+          uint32_t memberType = type.operands[member];
+          uint32_t memberSize = typeSize(memberType);
+
+          // column strides pad matrices past their packed size
+          if (
+            memberDecoration.count(DECORATION_MATRIX_STRIDE) > 0 &&
+            types.at(memberType).opcode == OP_TYPE_MATRIX
+          ) {
+            memberSize = (
+              memberDecoration[DECORATION_MATRIX_STRIDE] *
+              types.at(memberType).operands[1]
+            );
+          }
+
+          size = std::max(size, memberDecoration[DECORATION_OFFSET] + memberSize);
+        }
+        return size;
+      }
+      default:
+        return 0;
+    }
+  };
+
+  auto vertexFormat = [&](uint32_t typeId) -> VkFormat {
+    const SpirvType* type = &types.at(typeId);
+    uint32_t componentCount = 1;
+    if (type->opcode == OP_TYPE_VECTOR) {
+      componentCount = type->operands[1];
+      type = &types.at(type->operands[0]);
+    }
+
+    // the formats of each component type are consecutive, one to four
+    VkFormat first = VK_FORMAT_R32_SFLOAT;
+    if (type->opcode == OP_TYPE_INT) {
+      first = type->operands[1] ? VK_FORMAT_R32_SINT : VK_FORMAT_R32_UINT;
+    }
+
+    return static_cast<VkFormat>(first + 3 * (componentCount - 1));
+  };
+
+  for (const auto& [id, variable] : variables) {
+    const SpirvType& pointer = types.at(variable.pointerType);
+    uint32_t typeId = pointer.operands[1];
+
+    if (variable.storageClass == STORAGE_PUSH_CONSTANT) {
+      reflection.pushConstantSize = std::max(reflection.pushConstantSize, typeSize(typeId));
+      reflection.pushConstantStages = reflection.stage;
+      continue;
+    }
+
+    if (variable.storageClass == STORAGE_INPUT) {
+      // built-ins such as gl_VertexIndex are not fed by vertex buffers
+      if (
+        reflection.stage != VK_SHADER_STAGE_VERTEX_BIT ||
+        hasDecoration(id, DECORATION_BUILT_IN) ||
+        !hasDecoration(id, DECORATION_LOCATION)
+      ) {
+        continue;
+      }
+
+      // arrays take a location per element and matrices one per column,
+      // each fed by its own attribute
+      uint32_t locationCount = 1;
+      const SpirvType* inputType = &types.at(typeId);
+      if (inputType->opcode == OP_TYPE_ARRAY) {
+        locationCount = constants[inputType->operands[1]];
+        typeId = inputType->operands[0];
+        inputType = &types.at(typeId);
+      }
+      if (inputType->opcode == OP_TYPE_MATRIX) {
+        locationCount *= inputType->operands[1];
+        typeId = inputType->operands[0];
+      }
+
+      for (uint32_t i = 0; i < locationCount; ++i) {
+        VkVertexInputAttributeDescription attribute{};
+        attribute.location = decorations[id][DECORATION_LOCATION] + i;
+        attribute.binding = 0;
+        attribute.format = vertexFormat(typeId);
+        attribute.offset = typeSize(typeId);
+        reflection.vertexAttributes.push_back(attribute);
+      }
+      continue;
+    }
+
+    if (
+      variable.storageClass != STORAGE_UNIFORM_CONSTANT &&
+      variable.storageClass != STORAGE_UNIFORM &&
+      variable.storageClass != STORAGE_STORAGE_BUFFER
+    ) {
+      continue;
+    }
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = decorations[id][DECORATION_BINDING];
+    binding.descriptorCount = 1;
+    binding.stageFlags = reflection.stage;
+
+    // arrays of descriptors, runtime sized ones get a single slot
+    const SpirvType* type = &types.at(typeId);
+    if (type->opcode == OP_TYPE_ARRAY) {
+      binding.descriptorCount = constants[type->operands[1]];
+      typeId = type->operands[0];
+      type = &types.at(typeId);
+    } else if (type->opcode == OP_TYPE_RUNTIME_ARRAY) {
+      typeId = type->operands[0];
+      type = &types.at(typeId);
+    }
+
+    switch (type->opcode) {
+      case OP_TYPE_SAMPLER:
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+        break;
+      case OP_TYPE_SAMPLED_IMAGE:
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        break;
+      case OP_TYPE_IMAGE: {
+        // operands: sampled type, dim, depth, arrayed, ms, sampled
+        uint32_t dim = type->operands[1];
+        bool storage = type->operands[5] == 2;
+        if (dim == DIM_SUBPASS_DATA) {
+          binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        } else if (dim == DIM_BUFFER) {
+          binding.descriptorType = storage
+            ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+            : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+        } else {
+          binding.descriptorType = storage
+            ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+            : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        break;
+      }
+      case OP_TYPE_STRUCT:
+        binding.descriptorType = (
+          variable.storageClass == STORAGE_STORAGE_BUFFER ||
+          hasDecoration(typeId, DECORATION_BUFFER_BLOCK)
+        ) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        break;
+      default:
+        continue;
+    }
+
+    reflection.descriptorSets[decorations[id][DECORATION_DESCRIPTOR_SET]].push_back(binding);
+  }
+
+  for (auto& [set, bindings] : reflection.descriptorSets) {
+    std::sort(bindings.begin(), bindings.end(), [](const auto& a, const auto& b) {
+      return a.binding < b.binding;
+    });
+  }
+
+  for (const auto& [id, decoration] : decorations) {
+    auto specId = decoration.find(DECORATION_SPEC_ID);
+    if (specId != decoration.end()) {
+      reflection.specConstantIds.insert(specId->second);
+    }
+  }
+
+  // the sizes stashed in offset become the packed offsets
+  std::sort(
+    reflection.vertexAttributes.begin(), reflection.vertexAttributes.end(),
+    [](const auto& a, const auto& b) { return a.location < b.location; }
+  );
+  for (VkVertexInputAttributeDescription& attribute : reflection.vertexAttributes) {
+    uint32_t size = attribute.offset;
+    attribute.offset = reflection.vertexStride;
+    reflection.vertexStride += size;
+  }
+
+  return reflection;
+}
+
+// the stages of one pipeline share its layout, bindings used by both
+// get both stage flags
+static ShaderReflection mergeReflections(const std::vector<ShaderReflection>& stages) {
+  ShaderReflection merged;
+
+  for (const ShaderReflection& stage : stages) {
+    merged.stage |= stage.stage;
+    merged.pushConstantSize = std::max(merged.pushConstantSize, stage.pushConstantSize);
+    merged.pushConstantStages |= stage.pushConstantStages;
+    merged.specConstantIds.insert(stage.specConstantIds.begin(), stage.specConstantIds.end());
+
+    if (stage.stage == VK_SHADER_STAGE_VERTEX_BIT) {
+      merged.vertexAttributes = stage.vertexAttributes;
+      merged.vertexStride = stage.vertexStride;
+    }
+
+    for (const auto& [set, bindings] : stage.descriptorSets) {
+      std::vector<VkDescriptorSetLayoutBinding>& mergedBindings = merged.descriptorSets[set];
+
+      for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+        auto existing = std::find_if(
+          mergedBindings.begin(), mergedBindings.end(),
+          [&binding](const auto& other) { return other.binding == binding.binding; }
+        );
+
+        if (existing == mergedBindings.end()) {
+          mergedBindings.push_back(binding);
+        } else if (existing->descriptorType != binding.descriptorType) {
+          throw std::runtime_error("ERROR_CONFLICTING_DESCRIPTOR_BINDING");
+        } else {
+          existing->stageFlags |= binding.stageFlags;
+          existing->descriptorCount = std::max(existing->descriptorCount, binding.descriptorCount);
+        }
+      }
+
+      std::sort(mergedBindings.begin(), mergedBindings.end(), [](const auto& a, const auto& b) {
+        return a.binding < b.binding;
+      });
+    }
+  }
+
+  return merged;
+}
+
+// 8-bit RGB pixels, rows top to bottom
+struct RgbImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+};
+
+static void writePpm(const std::string& filename, const RgbImage& image) {
+  std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+  if (!file.is_open()) {
+    throw std::runtime_error("ERROR_OPEN_FILE - " + filename);
+  }
+
+  file << "P6\n" << image.width << " " << image.height << "\n255\n";
+  file.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size());
+}
+
+// only reads the binary, 8-bit flavor written by writePpm
+static std::optional<RgbImage> readPpm(const std::string& filename) {
+  std::ifstream file(filename, std::ios::binary);
+
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+
+  std::string magic;
+  uint32_t maxValue = 0;
+  RgbImage image;
+  file >> magic >> image.width >> image.height >> maxValue;
+  file.get();
+
+  if (!file || magic != "P6" || maxValue != 255) {
+    throw std::runtime_error("ERROR_INVALID_PPM - " + filename);
+  }
+
+  image.pixels.resize(size_t(image.width) * image.height * 3);
+  file.read(reinterpret_cast<char*>(image.pixels.data()), image.pixels.size());
+
+  if (!file) {
+    throw std::runtime_error("ERROR_INVALID_PPM - " + filename);
+  }
+
+  return image;
+}
+
+struct QueueFamilyIndices {
+  std::optional<uint32_t> graphicsFamily;
+  std::optional<uint32_t> presentationFamily;
+
+  bool isComplete() const {
+    return graphicsFamily.has_value() && presentationFamily.has_value();
+  }
+};
+
+struct SwapChainSupportDetails {
+    VkSurfaceCapabilitiesKHR capabilities;
+    std::vector<VkSurfaceFormatKHR> formats;
+    std::vector<VkPresentModeKHR> presentModes;
+};
+
+// what the app asks of a physical device, queried once when the device
+// is considered; only the surface capabilities are queried again, since
+// the current extent follows the window
+struct DeviceCapabilities {
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties properties{};
+  VkPhysicalDeviceFeatures features{};
+  // left zeroed where the API version or extension is missing
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  VkPhysicalDeviceVulkan13Features vulkan13Features{};
+  VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures{};
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  VkPhysicalDeviceMemoryProperties memoryProperties{};
+  std::vector<VkQueueFamilyProperties> queueFamilies;
+  QueueFamilyIndices queueFamilyIndices;
+  std::set<std::string> extensions;
+  // empty when headless
+  SwapChainSupportDetails swapChainSupport{};
+
+  bool hasExtension(const char* name) const {
+    return extensions.count(name) > 0;
+  }
+
+  bool hasExtensions(const std::vector<const char*>& names) const {
+    return std::all_of(names.begin(), names.end(), [this](const char* name) {
+      return hasExtension(name);
+    });
+  }
+};
+
+enum class FramePacing {
+  // one binary fence per frame slot
+  FENCES,
+  // a single timeline semaphore counting retired frames (Vulkan 1.2+)
+  TIMELINE
+};
+
+enum class PresentPolicy {
+  // MAILBOX, then IMMEDIATE, then FIFO
+  LOW_LATENCY,
+  // FIFO, never renders frames that will not be shown
+  POWER_SAVING,
+  // FIFO_RELAXED, tears instead of stuttering when a vblank is missed
+  ADAPTIVE
+};
+
+enum class CaptureFormat {
+  // binary RGB, viewable anywhere
+  PPM,
+  // the color target's bytes as-is, channel order in the file extension
+  RAW
+};
+
+enum class RenderingBackend {
+  // VkRenderPass plus a VkFramebuffer per color target
+  RENDER_PASS,
+  // vkCmdBeginRendering, core in Vulkan 1.3
+  DYNAMIC_RENDERING
+};
+
+struct AppSettings {
+  // number of frames the CPU may record ahead of the GPU
+  uint32_t framesInFlight = 2;
+  FramePacing pacing = FramePacing::FENCES;
+  PresentPolicy presentPolicy = PresentPolicy::LOW_LATENCY;
+  // falls back to RENDER_PASS on devices without dynamic rendering
+  RenderingBackend renderingBackend = RenderingBackend::RENDER_PASS;
+  // bind shaders as VK_EXT_shader_object objects with all state dynamic
+  // instead of building pipelines, needs dynamic rendering
+  bool shaderObjects = false;
+  // watch the GLSL sources in shaders/ and swap in recompiled shaders
+  // while running, needs glslc on the PATH and inotify
+  bool hotReload = false;
+  // compile shaders/shader.vert and shader.frag in-process instead of
+  // loading the SPIR-V built by compile_shaders.sh, needs "make SHADERC=1"
+  bool runtimeShaders = false;
+  // compiled SPIR-V by content hash, empty only caches in memory
+  std::string shaderCacheDir = "shader_cache";
+  // preprocessor defines for runtime compiles
+  std::vector<std::pair<std::string, std::string>> shaderDefines;
+  // set cull mode, front face, topology and depth state per command
+  // buffer on Vulkan 1.3 devices, instead of baking them into pipelines
+  bool extendedDynamicState = false;
+  // link pipelines from separately compiled parts where the device
+  // supports VK_EXT_graphics_pipeline_library
+  bool pipelineLibraries = false;
+  // physical device index or name substring, empty picks the highest
+  // scoring one, defaults to $HELLO_TRIANGLE_DEVICE
+  std::string physicalDevice;
+  // 0 picks the surface minimum plus one
+  uint32_t swapChainImageCount = 0;
+  // render into offscreen images without GLFW, a surface or presentation
+  bool headless = false;
+  // triangle specialization, see shaders/shader.frag and shader.vert
+  std::array<float, 3> triangleColor = {1.0f, 0.0f, 0.0f};
+  float triangleScale = 1.0f;
+  // stop after this many frames, 0 runs until the window is closed
+  uint32_t frameCount = 0;
+  // threads compiling pipelines in the background, 0 compiles them on
+  // the render thread as they are requested
+  uint32_t compileThreads = 2;
+  // threads running independent initVulkan() steps side by side, 0 runs
+  // them in sequence on the main thread
+  uint32_t initThreads = 3;
+  // pipeline cache file, loaded at startup and saved at shutdown,
+  // empty disables the on-disk cache
+  std::string pipelineCachePath = "pipeline_cache.bin";
+  // also write the startup breakdown printed after the first frame here
+  // as JSON, empty only prints it
+  std::string startupProfilePath;
+  // write every rendered frame into this directory, empty disables capture
+  std::string captureDir;
+  CaptureFormat captureFormat = CaptureFormat::PPM;
+  // keep the newest retired frame in memory, see lastFrame()
+  bool keepLastFrame = false;
+
+  // golden-image harness, renders the scenes and compares them against
+  // the references in goldenDir instead of running the app
+  std::string goldenDir;
+  // a single scene to run, empty runs all of them
+  std::string goldenScene;
+  // (re)write the references instead of comparing against them, the only
+  // way they get written
+  bool goldenUpdate = false;
+  // largest per-channel difference a pixel may have and still match
+  uint32_t goldenTolerance = 2;
+  // fail when a scene's frame time exceeds the baseline recorded on the
+  // same device by this factor
+  double goldenMaxSlowdown = 2.0;
+};
+
+struct PresentLatencyStats {
+  uint64_t frameCount = 0;
+  double totalMs = 0.0;
+  double maxMs = 0.0;
+};
+
+// a value for a shader's layout(constant_id = N) constant, stored as its
+// raw 32 bits so floats, ints and bools share one representation
+struct SpecializationConstant {
+  uint32_t constantId;
+  uint32_t value;
+  bool isFloat;
+};
+
+static SpecializationConstant specializeFloat(uint32_t constantId, float value) {
+  return {constantId, std::bit_cast<uint32_t>(value), true};
+}
+
+// constant ids declared in shaders/shader.frag and shaders/shader.vert
+const uint32_t SPEC_COLOR_R = 0;
+const uint32_t SPEC_COLOR_G = 1;
+const uint32_t SPEC_COLOR_B = 2;
+const uint32_t SPEC_TRIANGLE_SCALE = 3;
+
+// everything a graphics pipeline is built from, so that identical
+// requests can share one VkPipeline instead of compiling it again
+struct GraphicsPipelineDesc {
+  // shaders, each variant of their specialization constants is its own
+  // pipeline that the driver compiles with the values folded in
+  std::string vertShaderPath;
+  std::string fragShaderPath;
+  std::vector<SpecializationConstant> vertSpecialization;
+  std::vector<SpecializationConstant> fragSpecialization;
+  // bumped by every hot reload, so recompiled shaders never hit a
+  // variant built from the old SPIR-V
+  uint32_t shaderRevision = 0;
+
+  // vertex input
+  std::vector<VkVertexInputBindingDescription> vertexBindings;
+  std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  // rasterizer
+  VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+  VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+  VkFrontFace frontFace = VK_FRONT_FACE_CLOCKWISE;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+  // color blending, the defaults overwrite the target
+  bool blendEnable = false;
+  VkBlendFactor srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  VkBlendFactor dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+  VkBlendOp colorBlendOp = VK_BLEND_OP_ADD;
+  VkBlendFactor srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  VkBlendFactor dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  VkBlendOp alphaBlendOp = VK_BLEND_OP_ADD;
+  VkColorComponentFlags colorWriteMask = (
+    VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+    VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+  );
+
+  std::vector<VkDynamicState> dynamicStates;
+
+  // render targets
+  VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+  VkRenderPass renderPass = VK_NULL_HANDLE;
+  uint32_t subpass = 0;
+
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+
+  // FNV-1a over every field, computed by rehash() once the description
+  // is complete so lookups do not walk the fields again; descriptions
+  // used as map keys must go through it after their last change
+  size_t hash = 0;
+
+  void rehash() {
+    uint64_t value = 14695981039346656037ull;
+
+    auto add = [&value](const auto& field) {
+      value = fnv1a(value, &field, sizeof(field));
+    };
+    auto addString = [&value, &add](const std::string& string) {
+      add(string.size());
+      value = fnv1a(value, string.data(), string.size());
+    };
+    auto addSpecialization = [&add](
+      const std::vector<SpecializationConstant>& constants
+    ) {
+      add(constants.size());
+      for (const SpecializationConstant& constant : constants) {
+        add(constant.constantId);
+        add(constant.value);
+        add(constant.isFloat);
+      }
+    };
+
+    addString(vertShaderPath);
+    addString(fragShaderPath);
+    addSpecialization(vertSpecialization);
+    addSpecialization(fragSpecialization);
+    add(shaderRevision);
+
+    add(vertexBindings.size());
+    for (const VkVertexInputBindingDescription& binding : vertexBindings) {
+      add(binding.binding);
+      add(binding.stride);
+      add(binding.inputRate);
+    }
+
+    add(vertexAttributes.size());
+    for (const VkVertexInputAttributeDescription& attribute : vertexAttributes) {
+      add(attribute.location);
+      add(attribute.binding);
+      add(attribute.format);
+      add(attribute.offset);
+    }
+
+    add(topology);
+    add(polygonMode);
+    add(cullMode);
+    add(frontFace);
+    add(samples);
+
+    add(blendEnable);
+    add(srcColorBlendFactor);
+    add(dstColorBlendFactor);
+    add(colorBlendOp);
+    add(srcAlphaBlendFactor);
+    add(dstAlphaBlendFactor);
+    add(alphaBlendOp);
+    add(colorWriteMask);
+
+    add(dynamicStates.size());
+    for (VkDynamicState state : dynamicStates) {
+      add(state);
+    }
+
+    add(colorFormat);
+    add(renderPass);
+    add(subpass);
+    add(layout);
+
+    hash = static_cast<size_t>(value);
+  }
+
+  // field by field, without building anything on the way
+  bool operator==(const GraphicsPipelineDesc& other) const {
+    auto sameConstant = [](
+      const SpecializationConstant& a, const SpecializationConstant& b
+    ) {
+      return a.constantId == b.constantId && a.value == b.value && a.isFloat == b.isFloat;
+    };
+    auto sameBinding = [](
+      const VkVertexInputBindingDescription& a, const VkVertexInputBindingDescription& b
+    ) {
+      return a.binding == b.binding && a.stride == b.stride && a.inputRate == b.inputRate;
+    };
+    auto sameAttribute = [](
+      const VkVertexInputAttributeDescription& a, const VkVertexInputAttributeDescription& b
+    ) {
+      return (
+        a.location == b.location && a.binding == b.binding &&
+        a.format == b.format && a.offset == b.offset
+      );
+    };
+
+    return (
+      vertShaderPath == other.vertShaderPath &&
+      fragShaderPath == other.fragShaderPath &&
+      std::equal(
+        vertSpecialization.begin(), vertSpecialization.end(),
+        other.vertSpecialization.begin(), other.vertSpecialization.end(),
+        sameConstant
+      ) &&
+      std::equal(
+        fragSpecialization.begin(), fragSpecialization.end(),
+        other.fragSpecialization.begin(), other.fragSpecialization.end(),
+        sameConstant
+      ) &&
+      shaderRevision == other.shaderRevision &&
+      std::equal(
+        vertexBindings.begin(), vertexBindings.end(),
+        other.vertexBindings.begin(), other.vertexBindings.end(),
+        sameBinding
+      ) &&
+      std::equal(
+        vertexAttributes.begin(), vertexAttributes.end(),
+        other.vertexAttributes.begin(), other.vertexAttributes.end(),
+        sameAttribute
+      ) &&
+      topology == other.topology &&
+      polygonMode == other.polygonMode &&
+      cullMode == other.cullMode &&
+      frontFace == other.frontFace &&
+      samples == other.samples &&
+      blendEnable == other.blendEnable &&
+      srcColorBlendFactor == other.srcColorBlendFactor &&
+      dstColorBlendFactor == other.dstColorBlendFactor &&
+      colorBlendOp == other.colorBlendOp &&
+      srcAlphaBlendFactor == other.srcAlphaBlendFactor &&
+      dstAlphaBlendFactor == other.dstAlphaBlendFactor &&
+      alphaBlendOp == other.alphaBlendOp &&
+      colorWriteMask == other.colorWriteMask &&
+      dynamicStates == other.dynamicStates &&
+      colorFormat == other.colorFormat &&
+      renderPass == other.renderPass &&
+      subpass == other.subpass &&
+      layout == other.layout
+    );
+  }
+};
+
+struct GraphicsPipelineDescHash {
+  size_t operator()(const GraphicsPipelineDesc& desc) const {
+    return desc.hash;
+  }
+};
+
+// the four independently compiled parts of VK_EXT_graphics_pipeline_library
+enum class PipelineLibraryPart {
+  VERTEX_INPUT,
+  PRE_RASTERIZATION,
+  FRAGMENT_SHADER,
+  FRAGMENT_OUTPUT
+};
+
+struct PipelineVariantStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+// a pipeline that may still be compiling, holds the compile error on failure
+using PipelineFuture = std::shared_future<VkPipeline>;
+
+// runs jobs on a fixed set of threads, stop() finishes the queued jobs
+// before joining
+class WorkerPool {
+
+public:
+  ~WorkerPool() {
+    stop();
+  }
+
+  void start(uint32_t threadCount) {
+    for (uint32_t i = 0; i < threadCount; ++i) {
+      m_threads.emplace_back([this]() { work(); });
+    }
+  }
+
+  bool isRunning() const {
+    return !m_threads.empty();
+  }
+
+  void submit(std::function<void()> job) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_jobs.push_back(std::move(job));
+    }
+    m_jobAdded.notify_one();
+  }
+
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_jobAdded.notify_all();
+
+    for (std::thread& thread : m_threads) {
+      thread.join();
+    }
+    m_threads.clear();
+  }
+
+private:
+  void work() {
+    while (true) {
+      std::function<void()> job;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobAdded.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+
+        if (m_jobs.empty()) {
+          return;
+        }
+
+        job = std::move(m_jobs.front());
+        m_jobs.pop_front();
+      }
+
+      job();
+    }
+  }
+
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_jobAdded;
+  bool m_stopping = false;
+};
+
+// startup work as named steps with dependencies; run() starts every step
+// as soon as the ones it needs are done, so independent steps overlap
+class InitGraph {
+
+public:
+  // onCaller keeps a step on the thread calling run(), for APIs such as
+  // most of GLFW that only work from the main thread
+  void add(
+    const std::string& name,
+    std::vector<std::string> dependencies,
+    std::function<void()> step,
+    bool onCaller = false
+  ) {
+    m_nodes.push_back({name, std::move(dependencies), std::move(step), onCaller});
+  }
+
+  // threadCount 0 runs the steps one after another on the calling thread,
+  // in the order they were added; the first failing step's exception is
+  // rethrown once the steps already started are done
+  void run(uint32_t threadCount) {
+    std::unordered_map<std::string, size_t> indices;
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+      indices[m_nodes[i].name] = i;
+    }
+
+    std::vector<uint32_t> waitingOn(m_nodes.size(), 0);
+    std::vector<std::vector<size_t>> dependents(m_nodes.size());
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+      for (const std::string& dependency : m_nodes[i].dependencies) {
+        auto found = indices.find(dependency);
+        if (found == indices.end()) {
+          throw std::runtime_error("ERROR_UNKNOWN_INIT_DEPENDENCY - " + dependency);
+        }
+
+        // keeps the sequential order valid and rules out cycles
+        if (found->second > i) {
+          throw std::runtime_error("ERROR_INIT_DEPENDENCY_ORDER - " + m_nodes[i].name);
+        }
+
+        waitingOn[i]++;
+        dependents[found->second].push_back(i);
+      }
+    }
+
+    if (threadCount == 0) {
+      for (Node& node : m_nodes) {
+        node.step();
+      }
+      return;
+    }
+
+    std::mutex mutex;
+    std::condition_variable stepDone;
+    std::deque<size_t> callerSteps;
+    size_t started = 0;
+    size_t finished = 0;
+    std::exception_ptr failure;
+
+    WorkerPool workers;
+    workers.start(threadCount);
+
+    // both expect mutex to be held
+    std::function<void(size_t)> start;
+    auto complete = [&](size_t index, std::exception_ptr error) {
+      finished++;
+
+      if (error && !failure) {
+        failure = error;
+      }
+
+      if (!failure) {
+        for (size_t dependent : dependents[index]) {
+          if (--waitingOn[dependent] == 0) {
+            start(dependent);
+          }
+        }
+      }
+
+      stepDone.notify_all();
+    };
+
+    start = [&](size_t index) {
+      started++;
+
+      if (m_nodes[index].onCaller) {
+        callerSteps.push_back(index);
+        stepDone.notify_all();
+        return;
+      }
+
+      workers.submit([&, index]() {
+        std::exception_ptr error = runStep(index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        complete(index, error);
+      });
+    };
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      for (size_t i = 0; i < m_nodes.size(); ++i) {
+        if (waitingOn[i] == 0) {
+          start(i);
+        }
+      }
+
+      while (true) {
+        stepDone.wait(lock, [&]() {
+          return !callerSteps.empty() || finished == started;
+        });
+
+        if (callerSteps.empty()) {
+          break;
+        }
+
+        size_t index = callerSteps.front();
+        callerSteps.pop_front();
+
+        lock.unlock();
+        std::exception_ptr error = failure ? nullptr : runStep(index);
+        lock.lock();
+
+        complete(index, error);
+      }
+    }
+
+    workers.stop();
+
+    if (failure) {
+      std::rethrow_exception(failure);
+    }
+  }
+
+private:
+  struct Node {
+    std::string name;
+    std::vector<std::string> dependencies;
+    std::function<void()> step;
+    bool onCaller;
+  };
+
+  std::exception_ptr runStep(size_t index) {
+    try {
+      m_nodes[index].step();
+    } catch (...) {
+      return std::current_exception();
+    }
+    return nullptr;
+  }
+
+  std::vector<Node> m_nodes;
+};
+
+// wall-clock breakdown of startup, every entry is placed relative to
+// begin(); entries may be recorded from worker threads
+class StartupProfiler {
+
+public:
+  using Clock = std::chrono::steady_clock;
+
+  void begin() {
+    m_origin = Clock::now();
+    m_active = true;
+  }
+
+  bool isActive() const {
+    return m_active;
+  }
+
+  template <typename Function>
+  void stage(const char* name, Function&& function) {
+    if (!m_active) {
+      function();
+      return;
+    }
+
+    Clock::time_point start = Clock::now();
+    function();
+    record(name, start, Clock::now());
+  }
+
+  void record(const std::string& name, Clock::time_point start, Clock::time_point end) {
+    if (!m_active) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.push_back({name, milliseconds(m_origin, start), milliseconds(start, end)});
+  }
+
+  // a span from begin() to now, for milestones such as the first frame
+  void mark(const std::string& name) {
+    record(name, m_origin, Clock::now());
+  }
+
+  // prints the table and, given a path, writes the same entries as JSON;
+  // nothing is recorded afterwards
+  void finish(const std::string& jsonPath) {
+    if (!m_active) {
+      return;
+    }
+    m_active = false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-28s %12s %12s", "stage", "start ms", "duration ms");
+    std::cout << "STARTUP: " << line << '\n';
+    for (const Entry& entry : m_entries) {
+      std::snprintf(
+        line, sizeof(line), "%-28s %12.3f %12.3f",
+        entry.name.c_str(), entry.startMs, entry.durationMs
+      );
+      std::cout << "STARTUP: " << line << '\n';
+    }
+
+    if (jsonPath.empty()) {
+      return;
+    }
+
+    std::ofstream file(jsonPath, std::ios::trunc);
+    if (!file.is_open()) {
+      std::cerr << "STARTUP: failed to write " << jsonPath << '\n';
+      return;
+    }
+
+    file << "{\n  \"stages\": [\n";
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+      const Entry& entry = m_entries[i];
+      file << "    {\"name\": \"" << entry.name << "\", \"start_ms\": " << entry.startMs
+        << ", \"duration_ms\": " << entry.durationMs << "}"
+        << (i + 1 < m_entries.size() ? "," : "") << "\n";
+    }
+    file << "  ]\n}\n";
+  }
+
+private:
+  struct Entry {
+    std::string name;
+    double startMs;
+    double durationMs;
+  };
+
+  static double milliseconds(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  }
+
+  Clock::time_point m_origin;
+  std::atomic<bool> m_active = false;
+  std::mutex m_mutex;
+  std::vector<Entry> m_entries;
+};
+
+// converts and writes captured frames on its own thread, so the render
+// loop only pays for one copy out of the readback buffer; when the disk
+// falls behind, frames are dropped instead of queued without bound
+class CaptureWriter {
+
+public:
+  // 4 bytes per pixel, rows top to bottom, tightly packed
+  struct Frame {
+    uint64_t frameNumber = 0;
+    VkExtent2D extent{};
+    bool bgra = false;
+    std::vector<char> pixels;
+  };
+
+  ~CaptureWriter() {
+    stop();
+  }
+
+  void start(std::string directory, CaptureFormat format, size_t maxQueued) {
+    m_directory = std::move(directory);
+    m_format = format;
+    m_maxQueued = maxQueued;
+    m_stopping = false;
+    m_thread = std::thread([this]() { work(); });
+  }
+
+  bool isRunning() const {
+    return m_thread.joinable();
+  }
+
+  // a buffer from an earlier frame to fill, avoids an allocation per frame
+  std::vector<char> takeBuffer() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_freeBuffers.empty()) {
+      return {};
+    }
+
+    std::vector<char> buffer = std::move(m_freeBuffers.back());
+    m_freeBuffers.pop_back();
+    return buffer;
+  }
+
+  // never blocks, rethrows a failed write on the render thread
+  void push(Frame frame) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      rethrowError();
+
+      if (m_frames.size() >= m_maxQueued) {
+        m_droppedFrames++;
+        m_freeBuffers.push_back(std::move(frame.pixels));
+        return;
+      }
+
+      m_frames.push_back(std::move(frame));
+    }
+    m_frameAdded.notify_one();
+  }
+
+  // blocks until every queued frame is on disk
+  void flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_frameWritten.wait(lock, [this]() { return m_frames.empty() && !m_writing; });
+    rethrowError();
+  }
+
+  void stop() {
+    if (!m_thread.joinable()) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stopping = true;
+    }
+    m_frameAdded.notify_all();
+    m_thread.join();
+  }
+
+  uint64_t writtenFrames() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_writtenFrames;
+  }
+
+  uint64_t droppedFrames() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_droppedFrames;
+  }
+
+private:
+  void rethrowError() {
+    if (m_error) {
+      std::exception_ptr error = m_error;
+      m_error = nullptr;
+      std::rethrow_exception(error);
+    }
+  }
+
+  void work() {
+    while (true) {
+      Frame frame;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_frameAdded.wait(lock, [this]() { return m_stopping || !m_frames.empty(); });
+
+        if (m_frames.empty()) {
+          return;
+        }
+
+        frame = std::move(m_frames.front());
+        m_frames.pop_front();
+        m_writing = true;
+      }
+
+      std::exception_ptr error;
+      try {
+        write(frame);
+      } catch (...) {
+        error = std::current_exception();
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writing = false;
+        if (error) {
+          m_error = error;
+        } else {
+          m_writtenFrames++;
+        }
+        m_freeBuffers.push_back(std::move(frame.pixels));
+      }
+      m_frameWritten.notify_all();
+    }
+  }
+
+  void write(const Frame& frame) {
+    char frameName[32];
+    std::snprintf(
+      frameName, sizeof(frameName), "frame_%06llu",
+      static_cast<unsigned long long>(frame.frameNumber)
+    );
+
+    std::string filename = m_directory + "/" + frameName;
+    size_t rowSize = size_t(frame.extent.width) * 4;
+
+    if (m_format == CaptureFormat::RAW) {
+      filename += "_" + std::to_string(frame.extent.width) + "x" +
+        std::to_string(frame.extent.height) + (frame.bgra ? ".bgra" : ".rgba");
+    } else {
+      filename += ".ppm";
+    }
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+
+    if (!file.is_open()) {
+      throw std::runtime_error("ERROR_OPEN_FILE - " + filename);
+    }
+
+    if (m_format == CaptureFormat::RAW) {
+      file.write(frame.pixels.data(), rowSize * frame.extent.height);
+      return;
+    }
+
+    file << "P6\n" << frame.extent.width << " " << frame.extent.height << "\n255\n";
+
+    // PPM has no alpha, drop it one row at a time
+    m_row.resize(size_t(frame.extent.width) * 3);
+    int red = frame.bgra ? 2 : 0;
+    int blue = frame.bgra ? 0 : 2;
+
+    for (uint32_t y = 0; y < frame.extent.height; ++y) {
+      const char* row = frame.pixels.data() + y * rowSize;
+      for (uint32_t x = 0; x < frame.extent.width; ++x) {
+        m_row[x * 3 + 0] = row[x * 4 + red];
+        m_row[x * 3 + 1] = row[x * 4 + 1];
+        m_row[x * 3 + 2] = row[x * 4 + blue];
+      }
+      file.write(m_row.data(), m_row.size());
+    }
+  }
+
+  std::string m_directory;
+  CaptureFormat m_format = CaptureFormat::PPM;
+  size_t m_maxQueued = 0;
+
+  std::thread m_thread;
+  std::mutex m_mutex;
+  std::condition_variable m_frameAdded;
+  std::condition_variable m_frameWritten;
+  std::deque<Frame> m_frames;
+  std::vector<std::vector<char>> m_freeBuffers;
+  bool m_stopping = false;
+  bool m_writing = false;
+  std::exception_ptr m_error;
+  uint64_t m_writtenFrames = 0;
+  uint64_t m_droppedFrames = 0;
+
+  // only touched by the writer thread
+  std::vector<char> m_row;
+};
+
+// reports GLSL sources in a directory that were written or moved in,
+// without blocking; a no-op where there is no inotify
+class ShaderWatcher {
+
+public:
+  ~ShaderWatcher() {
+    stop();
+  }
+
+  bool start(const std::string& directory) {
+#ifdef HAS_INOTIFY
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_fd < 0) {
+      return false;
+    }
+
+    // editors that save through a rename show up as IN_MOVED_TO
+    if (inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+      stop();
+      return false;
+    }
+
+    return true;
+#else
+    (void) directory;
+    return false;
+#endif
+  }
+
+  void stop() {
+#ifdef HAS_INOTIFY
+    if (m_fd >= 0) {
+      close(m_fd);
+      m_fd = -1;
+    }
+#endif
+  }
+
+  // names of the .vert and .frag files changed since the last poll,
+  // each once however many events a save produced
+  std::set<std::string> poll() {
+    std::set<std::string> changed;
+
+#ifdef HAS_INOTIFY
+    if (m_fd < 0) {
+      return changed;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+      ssize_t length = read(m_fd, buffer, sizeof(buffer));
+      if (length <= 0) {
+        break;
+      }
+
+      for (ssize_t offset = 0; offset < length;) {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+
+        if (event->len == 0) {
+          continue;
+        }
+
+        std::string name = event->name;
+        if (name.ends_with(".vert") || name.ends_with(".frag")) {
+          changed.insert(name);
+        }
+      }
+    }
+#endif
+
+    return changed;
+  }
+
+private:
+#ifdef HAS_INOTIFY
+  int m_fd = -1;
+#endif
+};
+
+class HelloTriangleApp {
+
+private:
+  GLFWwindow * m_window;
+  uint32_t m_windowWidth = 100;
+  uint32_t m_windowHeight = 100;
+
+  VkInstance m_vkInstance;
+
+  VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
+  DeviceCapabilities m_capabilities;
+  VkDevice m_logicalDevice;
+  PFN_vkGetDeviceProcAddr m_getDeviceProcAddr = nullptr;
+  DeviceDispatch m_vk;
+
+  VkSurfaceKHR m_vkSurface;
+
+  // in headless mode the "swapchain" images are the offscreen targets
+  VkSwapchainKHR m_vkSwapChain;
+  std::vector<VkImage> m_swapChainImages;
+  VkFormat m_swapChainImageFormat;
+  VkExtent2D m_swapChainExtent;
+  std::vector<VkImageView> m_swapChainImageViews;
+  std::vector<VkFramebuffer> m_swapChainFramebuffers;
+
+  std::vector<VkDeviceMemory> m_offscreenImageMemory;
+  VkImageLayout m_colorTargetFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+  VkQueue m_graphicsQueue;
+  VkQueue m_presentationQueue;
+
+  VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+  // every pipeline requested so far, finished or not, owned here and
+  // destroyed in cleanup(); only touched by the main thread, which runs
+  // the create_graphics_pipeline init step and then the render loop
+  std::unordered_map<
+    GraphicsPipelineDesc, PipelineFuture, GraphicsPipelineDescHash
+  > m_pipelineVariants;
+  PipelineVariantStats m_pipelineVariantStats;
+  WorkerPool m_pipelineCompiler;
+
+  // shared parts of the linked pipelines, per PipelineLibraryPart; the
+  // compile workers fill them, hence the mutex
+  bool m_pipelineLibrariesEnabled = false;
+  std::unordered_map<
+    GraphicsPipelineDesc, VkPipeline, GraphicsPipelineDescHash
+  > m_pipelineLibraries[4];
+  std::mutex m_pipelineLibraryMutex;
+
+  bool m_extendedDynamicStateEnabled = false;
+
+  // shader objects per stage, keyed on the stage's path and specialization
+  // only; m_vertShaderObject and m_fragShaderObject are the triangle's
+  bool m_shaderObjectsEnabled = false;
+  std::unordered_map<
+    GraphicsPipelineDesc, VkShaderEXT, GraphicsPipelineDescHash
+  > m_shaderObjects;
+
+  // hot reload; glslc runs on the pipeline compiler's workers and the
+  // replaced pipelines wait in m_stalePipelines until the new one is ready
+  bool m_hotReloadEnabled = false;
+  uint32_t m_shaderRevision = 0;
+  StartupProfiler m_startupProfiler;
+  // whether the frame being recorded has the triangle in it, or only the
+  // clear while its pipeline compiles
+  bool m_frameDrawsTriangle = false;
+
+  // set when shaders are compiled from GLSL at runtime
+  std::unique_ptr<ShaderCompiler> m_shaderCompiler;
+  ShaderWatcher m_shaderWatcher;
+  std::vector<std::shared_future<bool>> m_shaderRecompiles;
+  std::vector<PipelineFuture> m_stalePipelines;
+  // a reloaded triangle pipeline is compiling, the stale ones still draw
+  bool m_reloadPending = false;
+  VkShaderEXT m_vertShaderObject = VK_NULL_HANDLE;
+  VkShaderEXT m_fragShaderObject = VK_NULL_HANDLE;
+
+  // extension commands are not exported by the loader
+  struct ShaderObjectFunctions {
+    PFN_vkCreateShadersEXT createShaders = nullptr;
+    PFN_vkDestroyShaderEXT destroyShader = nullptr;
+    PFN_vkCmdBindShadersEXT cmdBindShaders = nullptr;
+    PFN_vkCmdSetVertexInputEXT cmdSetVertexInput = nullptr;
+    PFN_vkCmdSetPolygonModeEXT cmdSetPolygonMode = nullptr;
+    PFN_vkCmdSetRasterizationSamplesEXT cmdSetRasterizationSamples = nullptr;
+    PFN_vkCmdSetSampleMaskEXT cmdSetSampleMask = nullptr;
+    PFN_vkCmdSetAlphaToCoverageEnableEXT cmdSetAlphaToCoverageEnable = nullptr;
+    PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable = nullptr;
+    PFN_vkCmdSetColorWriteMaskEXT cmdSetColorWriteMask = nullptr;
+    PFN_vkCmdSetColorBlendEquationEXT cmdSetColorBlendEquation = nullptr;
+  };
+  ShaderObjectFunctions m_shaderObjectFunctions;
+
+  // the triangle pipeline, drawn with m_fallbackPipeline until it is
+  // compiled, or not drawn at all when there is no fallback; with
+  // extended dynamic state its raster state is set from the description
+  // in recordCommandBuffer()
+  GraphicsPipelineDesc m_trianglePipelineDesc;
+  PipelineFuture m_graphicsPipeline;
+  VkPipeline m_fallbackPipeline = VK_NULL_HANDLE;
+  size_t m_triangleColorIndex = 0;
+  // both stay VK_NULL_HANDLE/empty with dynamic rendering
+  bool m_dynamicRenderingEnabled = false;
+  VkRenderPass m_renderPass = VK_NULL_HANDLE;
+  // layouts derived by shader reflection, deduplicated by content so
+  // shaders with the same interface share set layouts and pipeline layouts;
+  // first filled by the prepare_shaders init step on whichever thread the
+  // init graph picks, the main thread only from then on
+  struct PipelineLayoutInfo {
+    VkPipelineLayout layout;
+    std::vector<VkDescriptorSetLayout> setLayouts;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+  };
+  std::map<std::vector<uint32_t>, VkDescriptorSetLayout> m_descriptorSetLayouts;
+  std::map<std::vector<uint64_t>, PipelineLayoutInfo> m_pipelineLayouts;
+
+  VkCommandPool m_commandPool;
+
+  // per frame in flight
+  std::vector<VkCommandBuffer> m_commandBuffers;
+  std::vector<VkSemaphore> m_imageAvailableSemaphores;
+  std::vector<VkFence> m_inFlightFences;
+  uint32_t m_currentFrame = 0;
+
+  // per swapchain image, since a present may still be waiting on it
+  // when the frame slot that signaled it comes around again
+  std::vector<VkSemaphore> m_renderFinishedSemaphores;
+
+  // frames are numbered from 1 in submission order, in timeline pacing
+  // m_frameTimeline is signaled with the frame number once it retires
+  uint64_t m_submittedFrame = 0;
+  uint64_t m_retiredFrame = 0;
+  std::vector<uint64_t> m_frameSlotNumbers;
+  VkSemaphore m_frameTimeline = VK_NULL_HANDLE;
+
+  // objects the GPU may still use, destroyed once frameNumber retires
+  struct DeferredDestroy {
+    uint64_t frameNumber;
+    std::function<void()> destroy;
+  };
+  std::deque<DeferredDestroy> m_deletionQueue;
+
+  bool m_framebufferResized = false;
+  bool m_presentPolicyChanged = false;
+
+  VkPresentModeKHR m_presentMode;
+
+  // latency from the start of a frame on the CPU until it is presented,
+  // per present mode the frame was presented with; without present wait
+  // only until its GPU work retires, which says nothing about the queue
+  // of images waiting for the display
+  struct PendingLatency {
+    uint64_t frameNumber;
+    std::chrono::steady_clock::time_point startTime;
+    VkPresentModeKHR presentMode;
+  };
+  bool m_presentWaitEnabled = false;
+  std::deque<PendingLatency> m_pendingLatencies;
+  std::map<VkPresentModeKHR, PresentLatencyStats> m_presentLatencyStats;
+
+  // host-visible copy of a frame slot's color target, read once the frame
+  // that wrote it has retired so capturing never waits on the GPU
+  struct ReadbackBuffer {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void* mapped = nullptr;
+    VkDeviceSize size = 0;
+    // frame whose pixels the buffer holds, 0 when there is nothing to write
+    uint64_t frameNumber = 0;
+    VkExtent2D extent;
+    VkFormat format;
+  };
+  std::vector<ReadbackBuffer> m_readbackRing;
+  CaptureWriter m_captureWriter;
+
+  // the newest retired frame as read back, converted by lastFrame()
+  CaptureWriter::Frame m_lastFrameCapture;
+  RgbImage m_lastFrame;
+
+  double m_msPerFrame = 0.0;
+
+  AppSettings m_settings;
+
+  VkDebugUtilsMessengerEXT m_debugMessenger;
+
+public:
+
+  HelloTriangleApp(
+    const int windowWidth = 640,
+    const int windowHeight = 480,
+    const AppSettings& settings = {}
+  ) {
+    m_windowWidth = windowWidth;
+    m_windowHeight = windowHeight;
+    m_settings = settings;
+
+    if (m_settings.framesInFlight == 0) {
+      throw std::runtime_error("ERROR_INVALID_FRAMES_IN_FLIGHT");
+    }
+  }
+
+  void run() {
+    m_startupProfiler.begin();
+
+    if (!m_settings.headless) {
+      m_startupProfiler.stage("init_window", [this]() { initWindow(); });
+    }
+    initVulkan();
+    mainLoop();
+    cleanup();
+  }
+
+  // the last frame rendered, when keepLastFrame is set
+  const RgbImage& lastFrame() {
+    const CaptureWriter::Frame& capture = m_lastFrameCapture;
+    size_t pixelCount = size_t(capture.extent.width) * capture.extent.height;
+
+    m_lastFrame.width = capture.extent.width;
+    m_lastFrame.height = capture.extent.height;
+    m_lastFrame.pixels.resize(pixelCount * 3);
+
+    int red = capture.bgra ? 2 : 0;
+    int blue = capture.bgra ? 0 : 2;
+
+    for (size_t i = 0; i < pixelCount; ++i) {
+      m_lastFrame.pixels[i * 3 + 0] = capture.pixels[i * 4 + red];
+      m_lastFrame.pixels[i * 3 + 1] = capture.pixels[i * 4 + 1];
+      m_lastFrame.pixels[i * 3 + 2] = capture.pixels[i * 4 + blue];
+    }
+
+    return m_lastFrame;
+  }
+
+  // average CPU time per frame of the last headless run
+  double msPerFrame() const {
+    return m_msPerFrame;
+  }
+
+  // the device the app ran on, as deviceName_driverVersion with anything
+  // but letters and digits replaced, usable in file names
+  std::string deviceId() const {
+    const VkPhysicalDeviceProperties& properties = m_capabilities.properties;
+
+    char driverVersion[16];
+    std::snprintf(driverVersion, sizeof(driverVersion), "%08x", properties.driverVersion);
+
+    std::string id = std::string(properties.deviceName) + "_" + driverVersion;
+    for (char& c : id) {
+      if (!std::isalnum(static_cast<unsigned char>(c))) {
+        c = '_';
+      }
+    }
+    return id;
+  }
+
+  const PipelineVariantStats& pipelineVariantStats() const {
+    return m_pipelineVariantStats;
+  }
+
+
+private:
+
+  void initWindow() {
+    glfwInit();
+
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+    m_window = glfwCreateWindow(
+      m_windowWidth, m_windowHeight, "Hello Triangle", nullptr, nullptr
+    );
+
+    glfwSetWindowUserPointer(m_window, this);
+    glfwSetFramebufferSizeCallback(m_window, framebufferResizeCallback);
+    glfwSetKeyCallback(m_window, keyCallback);
+  }
+
+  // 1, 2 and 3 switch between the present policies at runtime, C toggles
+  // culling, F flips the front face and V cycles the triangle color
+  static void keyCallback(
+    GLFWwindow* window,
+    int key,
+    int scancode,
+    int action,
+    int mods
+  ) {
+    if (action != GLFW_PRESS) {
+      return;
+    }
+
+    auto app = reinterpret_cast<HelloTriangleApp*>(
+      glfwGetWindowUserPointer(window)
+    );
+
+    switch (key) {
+      case GLFW_KEY_1:
+        app->setPresentPolicy(PresentPolicy::LOW_LATENCY);
+        break;
+      case GLFW_KEY_2:
+        app->setPresentPolicy(PresentPolicy::POWER_SAVING);
+        break;
+      case GLFW_KEY_3:
+        app->setPresentPolicy(PresentPolicy::ADAPTIVE);
+        break;
+      case GLFW_KEY_C:
+        app->setRasterState(
+          app->m_trianglePipelineDesc.cullMode == VK_CULL_MODE_NONE ?
+            VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE,
+          app->m_trianglePipelineDesc.frontFace
+        );
+        break;
+      case GLFW_KEY_V:
+        app->cycleTriangleColor();
+        break;
+      case GLFW_KEY_F:
+        app->setRasterState(
+          app->m_trianglePipelineDesc.cullMode,
+          app->m_trianglePipelineDesc.frontFace == VK_FRONT_FACE_CLOCKWISE ?
+            VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE
+        );
+        break;
+    }
+  }
+
+  // takes effect at the end of the current frame via swapchain recreation
+  void setPresentPolicy(PresentPolicy policy) {
+    if (policy == m_settings.presentPolicy) {
+      return;
+    }
+
+    m_settings.presentPolicy = policy;
+    m_presentPolicyChanged = true;
+  }
+
+  static void framebufferResizeCallback(
+    GLFWwindow* window,
+    int width,
+    int height
+  ) {
+    auto app = reinterpret_cast<HelloTriangleApp*>(
+      glfwGetWindowUserPointer(window)
+    );
+    app->m_framebufferResized = true;
+  }
+
+  void setupDebugMessenger() {
+      if (!enableValidationLayers) return;
+
+      VkDebugUtilsMessengerCreateInfoEXT createInfo;
+      populateDebugMessengerCreateInfo(createInfo);
+
+      VkResult result = CreateDebugUtilsMessengerEXT(
+        m_vkInstance, &createInfo, nullptr, &m_debugMessenger
+      );
+
+      if (result != VK_SUCCESS) {
+          throw std::runtime_error("ERROR_FAILED_SETUP_DEBUG_MESSENGER");
+      }
+  }
+
+  void createVkInstance() {
+    std::cout << "CREATE_VK_INSTANCE" << '\n';
+
+    if (enableValidationLayers && !checkValidationLayerSupport()) {
+        throw std::runtime_error("validation layers requested, but not available!");
+    }
+
+    // declare necessary structures
+    VkApplicationInfo appInfo{};
+    appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    appInfo.pApplicationName = "Hello Triangle";
+    appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.pEngineName = "No Engine";
+    appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+    appInfo.apiVersion = VK_API_VERSION_1_3;
+
+    VkInstanceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &appInfo;
+
+    // obtain GLFW extensions
+    auto extensions = getRequiredExtensions();
+
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+
+    // debugging
+    VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
+    if (enableValidationLayers) {
+        createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+        createInfo.ppEnabledLayerNames = validationLayers.data();
+
+        populateDebugMessengerCreateInfo(debugCreateInfo);
+        createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*) &debugCreateInfo;
+    } else {
+        createInfo.enabledLayerCount = 0;
+        createInfo.pNext = nullptr;
+    }
+
+    // display some info about VK extensions
+    uint32_t extPropertyCount = 0;
+    vkEnumerateInstanceExtensionProperties(
+      nullptr,
+      &extPropertyCount,
+      nullptr
+    );
+
+    std::vector<VkExtensionProperties> extProperties(extPropertyCount);
+    vkEnumerateInstanceExtensionProperties(
+      nullptr,
+      &extPropertyCount,
+      extProperties.data()
+    );
+
+    std::cout << "VK_EXT_PROP_COUNT: " << extPropertyCount << '\n';
+
+    std::cout << "EXT_PROP_VECTOR_SIZE: " << extProperties.size() << '\n';;
+    for (const auto& ext : extProperties) {
+      std::cout << '\t' << ext.extensionName << std::endl;
+    }
+
+    // proceed with creating the VK instance
+    VkResult result = vkCreateInstance(&createInfo, nullptr, &m_vkInstance);
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAILED_TO_CREATE_VK_INSTANCE");
+    }
+  }
+
+  void createSurface() {
+    VkResult result = glfwCreateWindowSurface(
+      m_vkInstance, m_window, nullptr, &m_vkSurface
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAILED_CREATE_WINDOW_SURFACE");
+    }
+  }
+
+  void pickPhysicalDevice() {
+    // count the devices
+    uint32_t deviceCount = 0;
+    vkEnumeratePhysicalDevices(m_vkInstance, &deviceCount, nullptr);
+
+    // no devices handling
+    if (deviceCount == 0) {
+      throw std::runtime_error("ERROR_NO_PHYSICAL_DEVICES_AVAILABLE");
+    }
+
+    // get all devices
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vkEnumeratePhysicalDevices(m_vkInstance, &deviceCount, devices.data());
+
+    struct RankedDevice {
+      uint32_t index;
+      DeviceCapabilities capabilities;
+      uint64_t score;
+      bool suitable;
+    };
+
+    std::vector<RankedDevice> ranking;
+    for (uint32_t i = 0; i < deviceCount; ++i) {
+      DeviceCapabilities capabilities = queryDeviceCapabilities(devices[i]);
+      uint64_t score = scoreDevice(capabilities);
+      bool suitable = isDeviceSuitable(capabilities);
+      ranking.push_back({i, std::move(capabilities), score, suitable});
+    }
+
+    // best first, ties keep the driver's order
+    std::stable_sort(ranking.begin(), ranking.end(), [](const auto& a, const auto& b) {
+      return a.suitable != b.suitable ? a.suitable : a.score > b.score;
+    });
+
+    for (size_t rank = 0; rank < ranking.size(); ++rank) {
+      const RankedDevice& device = ranking[rank];
+      const VkPhysicalDeviceProperties& properties = device.capabilities.properties;
+
+      std::cout << "DEVICE_RANK: " << rank + 1 << ". [" << device.index << "] "
+        << properties.deviceName << " (" << deviceTypeName(properties.deviceType)
+        << ", " << (deviceLocalMemorySize(device.capabilities) >> 20) << " MiB)"
+        << " score=" << device.score
+        << (device.suitable ? "" : " unsuitable") << '\n';
+    }
+
+    // the highest ranked device matching the override, by index or by
+    // case-insensitive name substring
+    const RankedDevice* selected = nullptr;
+    const std::string& requested = m_settings.physicalDevice;
+
+    if (requested.empty()) {
+      if (ranking.front().suitable) {
+        selected = &ranking.front();
+      }
+    } else {
+      bool byIndex = std::all_of(requested.begin(), requested.end(), [](unsigned char c) {
+        return std::isdigit(c);
+      });
+
+      for (const RankedDevice& device : ranking) {
+        bool matches = byIndex
+          ? device.index == std::stoul(requested)
+          : toLower(device.capabilities.properties.deviceName).find(toLower(requested)) != std::string::npos;
+
+        if (matches) {
+          selected = &device;
+          break;
+        }
+      }
+
+      if (selected == nullptr) {
+        throw std::runtime_error("ERROR_PHYSICAL_DEVICE_NOT_FOUND - " + requested);
+      }
+
+      if (!selected->suitable) {
+        throw std::runtime_error(
+          "ERROR_PHYSICAL_DEVICE_NOT_SUITABLE - " +
+          std::string(selected->capabilities.properties.deviceName)
+        );
+      }
+    }
+
+    // no device could be used
+    if (selected == nullptr) {
+      throw std::runtime_error("ERROR_NO_PHYISICAL_DEVICE_SUITABLE");
+    }
+
+    m_physicalDevice = selected->capabilities.physicalDevice;
+    m_capabilities = selected->capabilities;
+
+    std::cout << "DEVICE: " << m_capabilities.properties.deviceName << (
+      requested.empty() ? "" : " (override)"
+    ) << '\n';
+
+    // shader objects only work with dynamic rendering, so they bring it along
+    if (m_settings.shaderObjects) {
+      m_shaderObjectsEnabled = (
+        checkDynamicRenderingSupport(m_capabilities) &&
+        checkShaderObjectSupport(m_capabilities)
+      );
+
+      std::cout << "SHADER_OBJECTS: " << (
+        m_shaderObjectsEnabled ? "enabled" : "unsupported, using pipelines"
+      ) << '\n';
+    }
+
+    if (m_shaderObjectsEnabled) {
+      m_dynamicRenderingEnabled = true;
+    } else if (m_settings.renderingBackend == RenderingBackend::DYNAMIC_RENDERING) {
+      m_dynamicRenderingEnabled = checkDynamicRenderingSupport(m_capabilities);
+
+      std::cout << "DYNAMIC_RENDERING: " << (
+        m_dynamicRenderingEnabled ? "enabled" : "unsupported, using render passes"
+      ) << '\n';
+    }
+
+    // core in Vulkan 1.3, older devices bake the state into pipelines
+    if (m_settings.extendedDynamicState) {
+      m_extendedDynamicStateEnabled = (
+        m_capabilities.properties.apiVersion >= VK_API_VERSION_1_3
+      );
+
+      std::cout << "EXTENDED_DYNAMIC_STATE: " << (
+        m_extendedDynamicStateEnabled ? "enabled" : "unsupported, using static state"
+      ) << '\n';
+    }
+
+    // optional, the monolithic path works everywhere
+    if (m_settings.pipelineLibraries) {
+      m_pipelineLibrariesEnabled = checkPipelineLibrarySupport(m_capabilities);
+
+      std::cout << "PIPELINE_LIBRARIES: " << (
+        m_pipelineLibrariesEnabled ? "enabled" : "unsupported, using monolithic pipelines"
+      ) << '\n';
+    }
+
+    // measures latency up to the actual present instead of the GPU work
+    if (!m_settings.headless) {
+      m_presentWaitEnabled = checkPresentWaitSupport(m_capabilities);
+
+      std::cout << "PRESENT_WAIT: " << (
+        m_presentWaitEnabled ? "enabled" : "unsupported, measuring until frames retire"
+      ) << '\n';
+    }
+  }
+
+  std::vector<const char*> getRequiredDeviceExtensions() {
+    std::vector<const char*> extensions;
+
+    if (!m_settings.headless) {
+      extensions = swapChainDeviceExtensions;
+    }
+
+    if (m_pipelineLibrariesEnabled) {
+      extensions.insert(
+        extensions.end(),
+        pipelineLibraryDeviceExtensions.begin(),
+        pipelineLibraryDeviceExtensions.end()
+      );
+    }
+
+    if (m_shaderObjectsEnabled) {
+      extensions.insert(
+        extensions.end(),
+        shaderObjectDeviceExtensions.begin(),
+        shaderObjectDeviceExtensions.end()
+      );
+    }
+
+    if (m_presentWaitEnabled) {
+      extensions.insert(
+        extensions.end(),
+        presentWaitDeviceExtensions.begin(),
+        presentWaitDeviceExtensions.end()
+      );
+    }
+
+    return extensions;
+  }
+
+  void createLogicalDevice() {
+
+    // define create info for the device queues
+    const QueueFamilyIndices& indices = m_capabilities.queueFamilyIndices;
+
+    std::vector<VkDeviceQueueCreateInfo> devQueueCreateInfoVector;
+    std::set<uint32_t> uniqueQueueFamilies = {
+      indices.graphicsFamily.value(),
+      indices.presentationFamily.value()
+    };
+
+    float queuePriority = 1.0f;
+
+    for (const uint32_t queueFamily : uniqueQueueFamilies) {
+      VkDeviceQueueCreateInfo devQueueCreateInfo{};
+      devQueueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+      devQueueCreateInfo.queueFamilyIndex = queueFamily;
+      devQueueCreateInfo.queueCount = 1;
+      devQueueCreateInfo.pQueuePriorities = &queuePriority;
+
+      devQueueCreateInfoVector.push_back(devQueueCreateInfo);
+    }
+
+    // phyisical device features
+    VkPhysicalDeviceFeatures physicalDevFeatures{};
+
+    // feature structures are only chained when needed, devices without
+    // the matching version or extension reject them
+    void* featureChain = nullptr;
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features{};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      vulkan12Features.pNext = featureChain;
+      featureChain = &vulkan12Features;
+    }
+
+    VkPhysicalDeviceVulkan13Features vulkan13Features{};
+    vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    vulkan13Features.dynamicRendering = VK_TRUE;
+
+    if (m_dynamicRenderingEnabled) {
+      vulkan13Features.pNext = featureChain;
+      featureChain = &vulkan13Features;
+    }
+
+    VkPhysicalDeviceShaderObjectFeaturesEXT shaderObjectFeatures{};
+    shaderObjectFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT;
+    shaderObjectFeatures.shaderObject = VK_TRUE;
+
+    if (m_shaderObjectsEnabled) {
+      shaderObjectFeatures.pNext = featureChain;
+      featureChain = &shaderObjectFeatures;
+    }
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+    pipelineLibraryFeatures.sType = (
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT
+    );
+    pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+
+    if (m_pipelineLibrariesEnabled) {
+      pipelineLibraryFeatures.pNext = featureChain;
+      featureChain = &pipelineLibraryFeatures;
+    }
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    presentIdFeatures.presentId = VK_TRUE;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+    presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+    presentWaitFeatures.presentWait = VK_TRUE;
+
+    if (m_presentWaitEnabled) {
+      presentIdFeatures.pNext = featureChain;
+      presentWaitFeatures.pNext = &presentIdFeatures;
+      featureChain = &presentWaitFeatures;
+    }
+
+    // define create info for the logical device
+    VkDeviceCreateInfo devCreateInfo{};
+    devCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    devCreateInfo.pNext = featureChain;
+
+    devCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(
+      devQueueCreateInfoVector.size()
+    );
+    devCreateInfo.pQueueCreateInfos = devQueueCreateInfoVector.data();
+
+    devCreateInfo.pEnabledFeatures = &physicalDevFeatures;
+
+    std::vector<const char*> deviceExtensions = getRequiredDeviceExtensions();
     devCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
     devCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
-    if (enableValidationLayers) {
-      devCreateInfo.enabledLayerCount = static_cast<uint32_t>(
-        validationLayers.size()
-      );
-      devCreateInfo.ppEnabledLayerNames = validationLayers.data();
-    } else {
-      devCreateInfo.enabledLayerCount = 0;
+    if (enableValidationLayers) {
+      devCreateInfo.enabledLayerCount = static_cast<uint32_t>(
+        validationLayers.size()
+      );
+      devCreateInfo.ppEnabledLayerNames = validationLayers.data();
+    } else {
+      devCreateInfo.enabledLayerCount = 0;
+    }
+
+    // proceed with creating the logical device
+    VkResult result = vkCreateDevice(
+      m_physicalDevice, &devCreateInfo, nullptr, &m_logicalDevice
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_LOGICAL_DEVICE_CREATE_FAIL");
+    }
+
+    // initialize device queue
+    vkGetDeviceQueue(
+      m_logicalDevice,
+      indices.graphicsFamily.value(),
+      0,
+      &m_graphicsQueue
+    );
+    vkGetDeviceQueue(
+      m_logicalDevice,
+      indices.presentationFamily.value(),
+      0,
+      &m_presentationQueue
+    );
+
+    loadDeviceDispatch();
+
+    if (m_shaderObjectsEnabled) {
+      loadShaderObjectFunctions();
+    }
+  }
+
+  void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
+    refreshSurfaceCapabilities();
+    const SwapChainSupportDetails& swapChainSupport = m_capabilities.swapChainSupport;
+
+    VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
+    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+    VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
+
+    uint32_t imageCount = chooseSwapImageCount(swapChainSupport.capabilities);
+
+    VkSwapchainCreateInfoKHR createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+    createInfo.surface = m_vkSurface;
+
+    createInfo.minImageCount = imageCount;
+    createInfo.imageFormat = surfaceFormat.format;
+    createInfo.imageColorSpace = surfaceFormat.colorSpace;
+    createInfo.imageExtent = extent;
+    createInfo.imageArrayLayers = 1;
+    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+    // captures copy straight out of the swapchain image
+    if (isCaptureEnabled()) {
+      if (
+        !(swapChainSupport.capabilities.supportedUsageFlags &
+          VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+      ) {
+        throw std::runtime_error("ERROR_SWAPCHAIN_NO_TRANSFER_SRC");
+      }
+
+      createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    const QueueFamilyIndices& indices = m_capabilities.queueFamilyIndices;
+    uint32_t queueFamilyIndices[] = {
+      indices.graphicsFamily.value(),
+      indices.presentationFamily.value()
+    };
+
+    if (indices.graphicsFamily != indices.presentationFamily) {
+        createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        createInfo.queueFamilyIndexCount = 2;
+        createInfo.pQueueFamilyIndices = queueFamilyIndices;
+    } else {
+        createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        // createInfo.queueFamilyIndexCount = 0; // Optional
+        // createInfo.pQueueFamilyIndices = nullptr; // Optional
+    }
+
+    createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
+    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    createInfo.presentMode = presentMode;
+    createInfo.clipped = VK_TRUE;
+
+    // lets the driver reuse resources of the swapchain being replaced
+    createInfo.oldSwapchain = oldSwapChain;
+
+    VkResult result = vkCreateSwapchainKHR(
+      m_logicalDevice, &createInfo, nullptr, &m_vkSwapChain
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_SWAPCHAIN");
+    }
+
+    vkGetSwapchainImagesKHR(
+      m_logicalDevice, m_vkSwapChain, &imageCount, nullptr
+    );
+    m_swapChainImages.resize(imageCount);
+
+    vkGetSwapchainImagesKHR(
+      m_logicalDevice, m_vkSwapChain, &imageCount, m_swapChainImages.data()
+    );
+
+    m_swapChainImageFormat = surfaceFormat.format;
+    m_swapChainExtent = extent;
+    m_presentMode = presentMode;
+
+    std::cout << "SWAPCHAIN_PRESENT_MODE: " << presentModeName(presentMode) << '\n';
+    std::cout << "SWAPCHAIN_IMAGE_COUNT: " << imageCount << '\n';
+  }
+
+  // one device-local color target per frame in flight, so consecutive
+  // frames never render into an image the GPU is still working on
+  void createOffscreenTargets() {
+    m_swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+    m_swapChainExtent = {m_windowWidth, m_windowHeight};
+    m_colorTargetFinalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    m_swapChainImages.resize(m_settings.framesInFlight);
+    m_offscreenImageMemory.resize(m_settings.framesInFlight);
+
+    for (uint32_t i = 0; i < m_settings.framesInFlight; ++i) {
+      VkImageCreateInfo imageCreateInfo{};
+      imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageCreateInfo.format = m_swapChainImageFormat;
+      imageCreateInfo.extent = {m_swapChainExtent.width, m_swapChainExtent.height, 1};
+      imageCreateInfo.mipLevels = 1;
+      imageCreateInfo.arrayLayers = 1;
+      imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+      imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageCreateInfo.usage = (
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+      );
+      imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+      VkResult result = vkCreateImage(
+        m_logicalDevice, &imageCreateInfo, nullptr, &m_swapChainImages[i]
+      );
+
+      if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR_FAIL_CREATE_OFFSCREEN_IMAGE");
+      }
+
+      VkMemoryRequirements memRequirements;
+      vkGetImageMemoryRequirements(
+        m_logicalDevice, m_swapChainImages[i], &memRequirements
+      );
+
+      VkMemoryAllocateInfo allocInfo{};
+      allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+      allocInfo.allocationSize = memRequirements.size;
+      allocInfo.memoryTypeIndex = findMemoryType(
+        memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+      );
+
+      result = vkAllocateMemory(
+        m_logicalDevice, &allocInfo, nullptr, &m_offscreenImageMemory[i]
+      );
+
+      if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR_FAIL_ALLOCATE_OFFSCREEN_IMAGE_MEMORY");
+      }
+
+      vkBindImageMemory(
+        m_logicalDevice, m_swapChainImages[i], m_offscreenImageMemory[i], 0
+      );
+    }
+  }
+
+  std::optional<uint32_t> queryMemoryType(
+    uint32_t typeFilter,
+    VkMemoryPropertyFlags properties
+  ) {
+    const VkPhysicalDeviceMemoryProperties& memProperties = m_capabilities.memoryProperties;
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; ++i) {
+      if (
+        (typeFilter & (1 << i)) &&
+        (memProperties.memoryTypes[i].propertyFlags & properties) == properties
+      ) {
+        return i;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  uint32_t findMemoryType(
+    uint32_t typeFilter,
+    VkMemoryPropertyFlags properties
+  ) {
+    std::optional<uint32_t> memoryType = queryMemoryType(typeFilter, properties);
+
+    if (!memoryType.has_value()) {
+      throw std::runtime_error("ERROR_NO_SUITABLE_MEMORY_TYPE");
+    }
+
+    return memoryType.value();
+  }
+
+  void createImageViews() {
+    m_swapChainImageViews.resize(m_swapChainImages.size());
+
+    for (size_t i = 0; i < m_swapChainImages.size(); ++i) {
+      VkImageViewCreateInfo createInfo{};
+      createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      createInfo.image = m_swapChainImages[i];
+      createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      createInfo.format = m_swapChainImageFormat;
+
+      createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+      createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+      createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+      createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+      createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      createInfo.subresourceRange.baseMipLevel = 0;
+      createInfo.subresourceRange.levelCount = 1;
+      createInfo.subresourceRange.baseArrayLayer = 0;
+      createInfo.subresourceRange.layerCount = 1;
+
+      VkResult result = vkCreateImageView(
+        m_logicalDevice, &createInfo, nullptr, &m_swapChainImageViews[i]
+      );
+
+      if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR_FAIL_CREATE_IMAGE_VIEW");
+      }
+    }
+  }
+
+  void createRenderPass() {
+    // attachment description
+    VkAttachmentDescription colorAttachment{};
+    colorAttachment.format = m_swapChainImageFormat;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = m_colorTargetFinalLayout;
+
+    // subpasses and attachment references
+    VkAttachmentReference colorAttachmentRef{};
+    colorAttachmentRef.attachment = 0;
+    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpassDescription{};
+    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDescription.colorAttachmentCount = 1;
+    subpassDescription.pColorAttachments = &colorAttachmentRef;
+
+    VkSubpassDependency subpassDependencies[2]{};
+    subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependencies[0].dstSubpass = 0;
+    subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[0].srcAccessMask = 0;
+    subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    // orders the color writes and the final layout transition before a
+    // capture copies the image out
+    subpassDependencies[1].srcSubpass = 0;
+    subpassDependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    subpassDependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpassDependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpassDependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    subpassDependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    // render pass
+    VkRenderPassCreateInfo renderPassCreateInfo{};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = 1;
+    renderPassCreateInfo.pAttachments = &colorAttachment;
+    renderPassCreateInfo.subpassCount = 1;
+    renderPassCreateInfo.pSubpasses = &subpassDescription;
+    renderPassCreateInfo.dependencyCount = isCaptureEnabled() ? 2 : 1;
+    renderPassCreateInfo.pDependencies = subpassDependencies;
+
+    VkResult result = vkCreateRenderPass(
+      m_logicalDevice, &renderPassCreateInfo, nullptr, &m_renderPass
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_RENDER_PASS");
+    }
+
+  }
+
+  // seeds the cache with the data of a previous run, as long as it was
+  // written by the same driver for the same device
+  void createPipelineCache() {
+    std::vector<char> cacheData;
+    if (!m_settings.pipelineCachePath.empty()) {
+      cacheData = loadPipelineCacheData(m_settings.pipelineCachePath);
+    }
+
+    VkPipelineCacheCreateInfo cacheCreateInfo{};
+    cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheCreateInfo.initialDataSize = cacheData.size();
+    cacheCreateInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+    VkResult result = vkCreatePipelineCache(
+      m_logicalDevice, &cacheCreateInfo, nullptr, &m_pipelineCache
+    );
+
+    // drivers may still refuse data that passed the header checks
+    if (result != VK_SUCCESS && !cacheData.empty()) {
+      std::cout << "PIPELINE_CACHE: rejected by the driver, starting empty" << '\n';
+
+      cacheCreateInfo.initialDataSize = 0;
+      cacheCreateInfo.pInitialData = nullptr;
+      result = vkCreatePipelineCache(
+        m_logicalDevice, &cacheCreateInfo, nullptr, &m_pipelineCache
+      );
+    }
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_PIPELINE_CACHE");
+    }
+  }
+
+  // returns no data when the file is missing or does not match the device
+  std::vector<char> loadPipelineCacheData(const std::string& path) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open()) {
+      std::cout << "PIPELINE_CACHE: no cache at " << path << '\n';
+      return {};
+    }
+
+    std::vector<char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(data.data(), data.size());
+
+    VkPipelineCacheHeaderVersionOne header{};
+    if (!file || data.size() < sizeof(header)) {
+      std::cout << "PIPELINE_CACHE: truncated cache at " << path << '\n';
+      return {};
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    const VkPhysicalDeviceProperties& properties = m_capabilities.properties;
+
+    if (
+      header.headerSize < sizeof(header) ||
+      header.headerSize > data.size() ||
+      header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+    ) {
+      std::cout << "PIPELINE_CACHE: invalid header, starting empty" << '\n';
+      return {};
+    }
+
+    if (
+      header.vendorID != properties.vendorID ||
+      header.deviceID != properties.deviceID ||
+      std::memcmp(
+        header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE
+      ) != 0
+    ) {
+      std::cout << "PIPELINE_CACHE: written for another device or driver, "
+        << "starting empty" << '\n';
+      return {};
+    }
+
+    std::cout << "PIPELINE_CACHE: loaded " << data.size() << " bytes" << '\n';
+    return data;
+  }
+
+  // writes next to the target and renames over it, so a crash mid-write
+  // never leaves a truncated cache behind
+  void savePipelineCache() {
+    if (m_settings.pipelineCachePath.empty()) {
+      return;
+    }
+
+    size_t dataSize = 0;
+    vkGetPipelineCacheData(m_logicalDevice, m_pipelineCache, &dataSize, nullptr);
+
+    std::vector<char> data(dataSize);
+    VkResult result = vkGetPipelineCacheData(
+      m_logicalDevice, m_pipelineCache, &dataSize, data.data()
+    );
+
+    if (result != VK_SUCCESS || dataSize == 0) {
+      std::cout << "PIPELINE_CACHE: nothing to save" << '\n';
+      return;
+    }
+
+    std::string tempPath = m_settings.pipelineCachePath + ".tmp";
+    {
+      std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+      file.write(data.data(), dataSize);
+
+      if (!file) {
+        std::cerr << "PIPELINE_CACHE: failed to write " << tempPath << '\n';
+        return;
+      }
+    }
+
+    if (std::rename(tempPath.c_str(), m_settings.pipelineCachePath.c_str()) != 0) {
+      std::cerr << "PIPELINE_CACHE: failed to replace "
+        << m_settings.pipelineCachePath << '\n';
+      std::remove(tempPath.c_str());
+      return;
+    }
+
+    std::cout << "PIPELINE_CACHE: saved " << dataSize << " bytes" << '\n';
+  }
+
+  // the shader half of the triangle's description, which only needs the
+  // device: shader paths, specialization and the reflected layout
+  void prepareShaders() {
+    GraphicsPipelineDesc& desc = m_trianglePipelineDesc;
+    if (m_settings.runtimeShaders && ShaderCompiler::isAvailable()) {
+      m_shaderCompiler = std::make_unique<ShaderCompiler>(
+        m_settings.shaderCacheDir, m_settings.shaderDefines
+      );
+    } else if (m_settings.runtimeShaders) {
+      std::cout << "RUNTIME_SHADERS: built without shaderc, using precompiled SPIR-V" << '\n';
+    }
+
+    if (m_shaderCompiler) {
+      desc.vertShaderPath = "shaders/shader.vert";
+      desc.fragShaderPath = "shaders/shader.frag";
+      m_shaderCompiler->prewarm({desc.vertShaderPath, desc.fragShaderPath});
+    } else {
+      desc.vertShaderPath = "shaders/vert.spv";
+      desc.fragShaderPath = "shaders/frag.spv";
+    }
+    desc.vertSpecialization = {
+      specializeFloat(SPEC_TRIANGLE_SCALE, m_settings.triangleScale)
+    };
+    setTriangleColor(m_settings.triangleColor);
+
+    // before any pipeline is requested, the compile workers read
+    // m_hotReloadEnabled through loadShaderCode()
+    if (m_settings.hotReload) {
+      startShaderHotReload();
+    }
+
+    m_pipelineCompiler.start(m_settings.compileThreads);
+
+    reflectPipelineLayout(desc);
+  }
+
+  // the render target half, once the swapchain format and render pass
+  // are known
+  void createGraphicsPipeline() {
+    GraphicsPipelineDesc& desc = m_trianglePipelineDesc;
+
+    // no pipeline at all, the rest of the description is set as dynamic
+    // state in recordShaderObjectDraw()
+    if (m_shaderObjectsEnabled) {
+      requestTriangleVariant();
+      return;
+    }
+
+    // viewport and scissors are dynamic, so the pipeline survives
+    // swapchain recreation; they are set in recordCommandBuffer()
+    desc.dynamicStates = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+      VK_DYNAMIC_STATE_LINE_WIDTH
+    };
+
+    if (m_extendedDynamicStateEnabled) {
+      desc.dynamicStates.insert(desc.dynamicStates.end(), {
+        VK_DYNAMIC_STATE_CULL_MODE,
+        VK_DYNAMIC_STATE_FRONT_FACE,
+        VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+        VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+        VK_DYNAMIC_STATE_DEPTH_COMPARE_OP
+      });
+    }
+
+    desc.colorFormat = m_swapChainImageFormat;
+    desc.renderPass = m_renderPass;
+    desc.subpass = 0;
+
+    // the first frames go out without the triangle rather than waiting
+    m_graphicsPipeline = requestGraphicsPipeline(desc);
+  }
+
+  // with extended dynamic state only the command buffer changes, otherwise
+  // the matching variant is requested and the current pipeline keeps
+  // drawing until it is compiled
+  void setRasterState(VkCullModeFlags cullMode, VkFrontFace frontFace) {
+    m_trianglePipelineDesc.cullMode = cullMode;
+    m_trianglePipelineDesc.frontFace = frontFace;
+
+    if (m_extendedDynamicStateEnabled || m_shaderObjectsEnabled) {
+      return;
+    }
+
+    requestTriangleVariant();
+  }
+
+  void setTriangleColor(const std::array<float, 3>& color) {
+    m_trianglePipelineDesc.fragSpecialization = {
+      specializeFloat(SPEC_COLOR_R, color[0]),
+      specializeFloat(SPEC_COLOR_G, color[1]),
+      specializeFloat(SPEC_COLOR_B, color[2])
+    };
+  }
+
+  // V cycles through a few specialized colors, each one its own variant
+  void cycleTriangleColor() {
+    static const std::array<float, 3> colors[] = {
+      {1.0f, 0.0f, 0.0f},
+      {0.0f, 1.0f, 0.0f},
+      {0.0f, 0.0f, 1.0f}
+    };
+
+    m_triangleColorIndex = (m_triangleColorIndex + 1) % std::size(colors);
+    setTriangleColor(colors[m_triangleColorIndex]);
+    requestTriangleVariant();
+  }
+
+  // the current pipeline keeps drawing until the new variant is compiled,
+  // variants seen before are ready right away
+  void requestTriangleVariant() {
+    if (m_shaderObjectsEnabled) {
+      m_vertShaderObject = getShaderObject(m_trianglePipelineDesc, VK_SHADER_STAGE_VERTEX_BIT);
+      m_fragShaderObject = getShaderObject(m_trianglePipelineDesc, VK_SHADER_STAGE_FRAGMENT_BIT);
+      return;
+    }
+
+    m_fallbackPipeline = currentTrianglePipeline();
+    m_graphicsPipeline = requestGraphicsPipeline(m_trianglePipelineDesc);
+  }
+
+  // the triangle pipeline to draw with; when a reload or variant failed
+  // to build, such as after a shader edit that compiles but does not
+  // link, the pipeline from before stays until the next request
+  VkPipeline currentTrianglePipeline() {
+    if (
+      (m_reloadPending || m_fallbackPipeline != VK_NULL_HANDLE) &&
+      m_graphicsPipeline.valid() &&
+      m_graphicsPipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+    ) {
+      try {
+        m_graphicsPipeline.get();
+      } catch (const std::exception& error) {
+        std::cerr << error.what() << '\n';
+        std::cout << "HOT_RELOAD: pipeline build failed, keeping the old pipeline" << '\n';
+
+        std::promise<VkPipeline> fallback;
+        fallback.set_value(m_fallbackPipeline);
+        m_graphicsPipeline = fallback.get_future().share();
+        m_reloadPending = false;
+      }
+    }
+
+    return resolvePipeline(m_graphicsPipeline, m_fallbackPipeline);
+  }
+
+  // resolves vkGetDeviceProcAddr itself from the instance first, so the
+  // table holds the driver's entry points for this device
+  void loadDeviceDispatch() {
+    m_getDeviceProcAddr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(
+      vkGetInstanceProcAddr(m_vkInstance, "vkGetDeviceProcAddr")
+    );
+
+    if (m_getDeviceProcAddr == nullptr) {
+      throw std::runtime_error("ERROR_MISSING_DEVICE_FUNCTION - vkGetDeviceProcAddr");
+    }
+
+#define DEVICE_DISPATCH_LOAD(name) \
+    m_vk.name = reinterpret_cast<PFN_##name>(m_getDeviceProcAddr(m_logicalDevice, #name));
+    DEVICE_DISPATCH_FUNCTIONS(DEVICE_DISPATCH_LOAD)
+#undef DEVICE_DISPATCH_LOAD
+  }
+
+  template <typename T>
+  void loadDeviceFunction(T& function, const char* name) {
+    function = reinterpret_cast<T>(m_getDeviceProcAddr(m_logicalDevice, name));
+
+    if (function == nullptr) {
+      throw std::runtime_error(std::string("ERROR_MISSING_DEVICE_FUNCTION - ") + name);
+    }
+  }
+
+  void loadShaderObjectFunctions() {
+    ShaderObjectFunctions& functions = m_shaderObjectFunctions;
+    loadDeviceFunction(functions.createShaders, "vkCreateShadersEXT");
+    loadDeviceFunction(functions.destroyShader, "vkDestroyShaderEXT");
+    loadDeviceFunction(functions.cmdBindShaders, "vkCmdBindShadersEXT");
+    loadDeviceFunction(functions.cmdSetVertexInput, "vkCmdSetVertexInputEXT");
+    loadDeviceFunction(functions.cmdSetPolygonMode, "vkCmdSetPolygonModeEXT");
+    loadDeviceFunction(
+      functions.cmdSetRasterizationSamples, "vkCmdSetRasterizationSamplesEXT"
+    );
+    loadDeviceFunction(functions.cmdSetSampleMask, "vkCmdSetSampleMaskEXT");
+    loadDeviceFunction(
+      functions.cmdSetAlphaToCoverageEnable, "vkCmdSetAlphaToCoverageEnableEXT"
+    );
+    loadDeviceFunction(functions.cmdSetColorBlendEnable, "vkCmdSetColorBlendEnableEXT");
+    loadDeviceFunction(functions.cmdSetColorWriteMask, "vkCmdSetColorWriteMaskEXT");
+    loadDeviceFunction(
+      functions.cmdSetColorBlendEquation, "vkCmdSetColorBlendEquationEXT"
+    );
+  }
+
+  // compiled when first asked for, unlinked so each stage can be swapped
+  // on its own
+  VkShaderEXT getShaderObject(
+    const GraphicsPipelineDesc& desc,
+    VkShaderStageFlagBits stage
+  ) {
+    bool isVertex = stage == VK_SHADER_STAGE_VERTEX_BIT;
+
+    GraphicsPipelineDesc key{};
+    key.shaderRevision = desc.shaderRevision;
+    key.layout = desc.layout;
+    if (isVertex) {
+      key.vertShaderPath = desc.vertShaderPath;
+      key.vertSpecialization = desc.vertSpecialization;
+    } else {
+      key.fragShaderPath = desc.fragShaderPath;
+      key.fragSpecialization = desc.fragSpecialization;
+    }
+    key.rehash();
+
+    auto cached = m_shaderObjects.find(key);
+    if (cached != m_shaderObjects.end()) {
+      return cached->second;
+    }
+
+    SpirvBlob code = loadShaderCode(isVertex ? desc.vertShaderPath : desc.fragShaderPath);
+
+    std::vector<VkSpecializationMapEntry> specEntries;
+    std::vector<uint32_t> specData;
+    VkSpecializationInfo specInfo{};
+
+    VkShaderCreateInfoEXT shaderCreateInfo{};
+    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT;
+    shaderCreateInfo.stage = stage;
+    shaderCreateInfo.nextStage = isVertex ? VK_SHADER_STAGE_FRAGMENT_BIT : 0;
+    shaderCreateInfo.codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT;
+    shaderCreateInfo.codeSize = code.size();
+    shaderCreateInfo.pCode = code.words();
+    shaderCreateInfo.pName = "main";
+
+    // shader objects carry the layout a pipeline would otherwise have
+    const PipelineLayoutInfo& layout = findPipelineLayout(desc.layout);
+    shaderCreateInfo.setLayoutCount = static_cast<uint32_t>(layout.setLayouts.size());
+    shaderCreateInfo.pSetLayouts = layout.setLayouts.data();
+    shaderCreateInfo.pushConstantRangeCount = (
+      static_cast<uint32_t>(layout.pushConstantRanges.size())
+    );
+    shaderCreateInfo.pPushConstantRanges = layout.pushConstantRanges.data();
+    shaderCreateInfo.pSpecializationInfo = fillSpecializationInfo(
+      isVertex ? desc.vertSpecialization : desc.fragSpecialization,
+      specEntries, specData, specInfo
+    );
+
+    VkShaderEXT shader;
+    VkResult result = m_shaderObjectFunctions.createShaders(
+      m_logicalDevice, 1, &shaderCreateInfo, nullptr, &shader
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_SHADER_OBJECT");
+    }
+
+    m_shaderObjects.emplace(key, shader);
+    return shader;
+  }
+
+  // GLSL paths go through the runtime compiler, .spv paths are loaded;
+  // called from the pipeline compiler's workers too
+  SpirvBlob loadShaderCode(const std::string& path) {
+    if (m_shaderCompiler && !path.ends_with(".spv")) {
+      return SpirvBlob(m_shaderCompiler->compile(path));
+    }
+
+    return loadSpirv(path, m_hotReloadEnabled);
+  }
+
+  // derives the layout and vertex input of the description from its
+  // shaders' SPIR-V
+  void reflectPipelineLayout(GraphicsPipelineDesc& desc) {
+    ShaderReflection reflection = mergeReflections({
+      reflectSpirv(loadShaderCode(desc.vertShaderPath)),
+      reflectSpirv(loadShaderCode(desc.fragShaderPath))
+    });
+
+    desc.vertexBindings.clear();
+    desc.vertexAttributes = reflection.vertexAttributes;
+    if (!reflection.vertexAttributes.empty()) {
+      VkVertexInputBindingDescription binding{};
+      binding.binding = 0;
+      binding.stride = reflection.vertexStride;
+      binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+      desc.vertexBindings.push_back(binding);
+    }
+
+    desc.layout = getPipelineLayout(reflection).layout;
+
+    std::cout << "SHADER_REFLECTION: " << reflection.descriptorSets.size() << " sets, "
+      << reflection.pushConstantSize << " push constant bytes, "
+      << reflection.vertexAttributes.size() << " vertex attributes, "
+      << m_pipelineLayouts.size() << " pipeline layouts" << '\n';
+  }
+
+  VkDescriptorSetLayout getDescriptorSetLayout(
+    const std::vector<VkDescriptorSetLayoutBinding>& bindings
+  ) {
+    std::vector<uint32_t> key;
+    for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+      key.insert(key.end(), {
+        binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags
+      });
+    }
+
+    auto cached = m_descriptorSetLayouts.find(key);
+    if (cached != m_descriptorSetLayouts.end()) {
+      return cached->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    createInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    createInfo.pBindings = bindings.data();
+
+    VkDescriptorSetLayout setLayout;
+    VkResult result = vkCreateDescriptorSetLayout(
+      m_logicalDevice, &createInfo, nullptr, &setLayout
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_DESCRIPTOR_SET_LAYOUT");
+    }
+
+    m_descriptorSetLayouts.emplace(key, setLayout);
+    return setLayout;
+  }
+
+  // sets the shaders skip still get an empty layout, which deduplicates
+  // to a single object
+  const PipelineLayoutInfo& getPipelineLayout(const ShaderReflection& reflection) {
+    PipelineLayoutInfo info{};
+
+    uint32_t setCount = reflection.descriptorSets.empty()
+      ? 0 : reflection.descriptorSets.rbegin()->first + 1;
+    for (uint32_t set = 0; set < setCount; ++set) {
+      auto bindings = reflection.descriptorSets.find(set);
+      info.setLayouts.push_back(getDescriptorSetLayout(
+        bindings != reflection.descriptorSets.end()
+          ? bindings->second
+          : std::vector<VkDescriptorSetLayoutBinding>{}
+      ));
+    }
+
+    if (reflection.pushConstantSize > 0) {
+      info.pushConstantRanges.push_back(
+        {reflection.pushConstantStages, 0, reflection.pushConstantSize}
+      );
+    }
+
+    std::vector<uint64_t> key;
+    for (VkDescriptorSetLayout setLayout : info.setLayouts) {
+      key.push_back((uint64_t) setLayout);
+    }
+    for (const VkPushConstantRange& range : info.pushConstantRanges) {
+      key.insert(key.end(), {range.stageFlags, range.offset, range.size});
+    }
+
+    auto cached = m_pipelineLayouts.find(key);
+    if (cached != m_pipelineLayouts.end()) {
+      return cached->second;
+    }
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = static_cast<uint32_t>(info.setLayouts.size());
+    pipelineLayoutCreateInfo.pSetLayouts = info.setLayouts.data();
+    pipelineLayoutCreateInfo.pushConstantRangeCount = (
+      static_cast<uint32_t>(info.pushConstantRanges.size())
+    );
+    pipelineLayoutCreateInfo.pPushConstantRanges = info.pushConstantRanges.data();
+
+    VkResult result = vkCreatePipelineLayout(
+      m_logicalDevice, &pipelineLayoutCreateInfo, nullptr, &info.layout
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_PIPELINE_LAYOUT");
+    }
+
+    return m_pipelineLayouts.emplace(key, info).first->second;
+  }
+
+  const PipelineLayoutInfo& findPipelineLayout(VkPipelineLayout layout) {
+    for (const auto& [key, info] : m_pipelineLayouts) {
+      if (info.layout == layout) {
+        return info;
+      }
+    }
+
+    throw std::runtime_error("ERROR_UNKNOWN_PIPELINE_LAYOUT");
+  }
+
+  // returns the pipeline requested for an identical description earlier,
+  // only compiles on a miss; the compile runs on m_pipelineCompiler when
+  // it has threads, so the returned future may not be ready yet
+  PipelineFuture requestGraphicsPipeline(const GraphicsPipelineDesc& requestedDesc) {
+    GraphicsPipelineDesc desc = withoutDynamicState(requestedDesc);
+
+    auto cached = m_pipelineVariants.find(desc);
+    if (cached != m_pipelineVariants.end()) {
+      m_pipelineVariantStats.hits++;
+      return cached->second;
+    }
+
+    m_pipelineVariantStats.misses++;
+
+    auto promise = std::make_shared<std::promise<VkPipeline>>();
+    PipelineFuture future = promise->get_future().share();
+    m_pipelineVariants.emplace(desc, future);
+
+    // the pipeline cache is internally synchronized, so the workers
+    // can compile into it concurrently
+    auto compile = [this, desc, promise]() {
+      auto startTime = StartupProfiler::Clock::now();
+      try {
+        promise->set_value(buildGraphicsPipeline(desc));
+      } catch (...) {
+        promise->set_exception(std::current_exception());
+      }
+      m_startupProfiler.record("pipeline_compile", startTime, StartupProfiler::Clock::now());
+    };
+
+    if (m_pipelineCompiler.isRunning()) {
+      m_pipelineCompiler.submit(compile);
+    } else {
+      compile();
+    }
+
+    return future;
+  }
+
+  // resets the fields set by dynamic state, descriptions that only differ
+  // there share a pipeline; topology stays, since the pipeline still
+  // fixes its topology class
+  GraphicsPipelineDesc withoutDynamicState(const GraphicsPipelineDesc& desc) {
+    GraphicsPipelineDesc normalized = desc;
+    GraphicsPipelineDesc defaults{};
+
+    for (VkDynamicState state : desc.dynamicStates) {
+      switch (state) {
+        case VK_DYNAMIC_STATE_CULL_MODE:
+          normalized.cullMode = defaults.cullMode;
+          break;
+        case VK_DYNAMIC_STATE_FRONT_FACE:
+          normalized.frontFace = defaults.frontFace;
+          break;
+        default:
+          break;
+      }
+    }
+
+    normalized.rehash();
+    return normalized;
+  }
+
+  // blocks until the pipeline is compiled
+  VkPipeline getGraphicsPipeline(const GraphicsPipelineDesc& desc) {
+    return requestGraphicsPipeline(desc).get();
+  }
+
+  // the compiled pipeline if it is ready, the fallback otherwise
+  VkPipeline resolvePipeline(const PipelineFuture& future, VkPipeline fallback) {
+    if (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return fallback;
+    }
+
+    // rethrows compile errors
+    return future.get();
+  }
+
+  void reportPipelineVariantStats() {
+    std::cout << "PIPELINE_VARIANTS: " << m_pipelineVariants.size() << " pipelines, "
+      << m_pipelineVariantStats.hits << " hits, "
+      << m_pipelineVariantStats.misses << " misses" << '\n';
+
+    auto printSpecialization = [](const std::vector<SpecializationConstant>& constants) {
+      for (const SpecializationConstant& constant : constants) {
+        std::cout << " " << constant.constantId << "=";
+        if (constant.isFloat) {
+          std::cout << std::bit_cast<float>(constant.value);
+        } else {
+          std::cout << constant.value;
+        }
+      }
+    };
+
+    for (const auto& [desc, future] : m_pipelineVariants) {
+      std::cout << "PIPELINE_VARIANT: " << desc.vertShaderPath;
+      printSpecialization(desc.vertSpecialization);
+      std::cout << ", " << desc.fragShaderPath;
+      printSpecialization(desc.fragSpecialization);
+      std::cout << '\n';
+    }
+  }
+
+  // the state create infos of a graphics pipeline, filled from a
+  // description; they point into each other, so the struct stays in place
+  struct PipelineStateInfos {
+    VkShaderModule vertModule = VK_NULL_HANDLE;
+    VkShaderModule fragModule = VK_NULL_HANDLE;
+    VkPipelineShaderStageCreateInfo vertStage{};
+    VkPipelineShaderStageCreateInfo fragStage{};
+    std::vector<VkSpecializationMapEntry> vertSpecEntries;
+    std::vector<VkSpecializationMapEntry> fragSpecEntries;
+    std::vector<uint32_t> vertSpecData;
+    std::vector<uint32_t> fragSpecData;
+    VkSpecializationInfo vertSpecInfo{};
+    VkSpecializationInfo fragSpecInfo{};
+    VkPipelineVertexInputStateCreateInfo vertexInput{};
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    VkPipelineViewportStateCreateInfo viewport{};
+    VkPipelineRasterizationStateCreateInfo raster{};
+    VkPipelineMultisampleStateCreateInfo multisample{};
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    VkPipelineColorBlendStateCreateInfo colorBlend{};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    // only chained when there is no render pass
+    VkPipelineRenderingCreateInfo rendering{};
+  };
+
+  // only loads the shaders that are asked for, pipeline libraries
+  // build each stage on its own
+  void fillPipelineStateInfos(
+    const GraphicsPipelineDesc& desc,
+    PipelineStateInfos& infos,
+    bool withVertShader,
+    bool withFragShader
+  ) {
+    // obtain shaders SPIR-V code and create shader modules, a failure
+    // takes the modules created so far with it
+    try {
+      if (withVertShader) {
+        infos.vertModule = createShaderModule(loadShaderCode(desc.vertShaderPath));
+      }
+      if (withFragShader) {
+        infos.fragModule = createShaderModule(loadShaderCode(desc.fragShaderPath));
+      }
+    } catch (...) {
+      destroyShaderModules(infos);
+      throw;
+    }
+
+    // create shaders stages
+    infos.vertStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    infos.vertStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    infos.vertStage.module = infos.vertModule;
+    infos.vertStage.pName = "main";
+
+    infos.fragStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    infos.fragStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    infos.fragStage.module = infos.fragModule;
+    infos.fragStage.pName = "main";
+
+    infos.vertStage.pSpecializationInfo = fillSpecializationInfo(
+      desc.vertSpecialization,
+      infos.vertSpecEntries, infos.vertSpecData, infos.vertSpecInfo
+    );
+    infos.fragStage.pSpecializationInfo = fillSpecializationInfo(
+      desc.fragSpecialization,
+      infos.fragSpecEntries, infos.fragSpecData, infos.fragSpecInfo
+    );
+
+    // vertext input
+    infos.vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    infos.vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(
+      desc.vertexBindings.size()
+    );
+    infos.vertexInput.pVertexBindingDescriptions = desc.vertexBindings.data();
+    infos.vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(
+      desc.vertexAttributes.size()
+    );
+    infos.vertexInput.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+    // input assembly
+    infos.inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    infos.inputAssembly.topology = desc.topology;
+    infos.inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // viewport and scissors come from dynamic state
+    infos.viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+
+    infos.viewport.viewportCount = 1;
+    infos.viewport.pViewports = nullptr;
+
+    infos.viewport.scissorCount = 1;
+    infos.viewport.pScissors = nullptr;
+
+    // rasterizer
+    infos.raster.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    infos.raster.depthClampEnable = VK_FALSE;
+    infos.raster.rasterizerDiscardEnable = VK_FALSE;
+    infos.raster.polygonMode = desc.polygonMode;
+    infos.raster.lineWidth = 1.0f;
+    infos.raster.cullMode = desc.cullMode;
+    infos.raster.frontFace = desc.frontFace;
+    infos.raster.depthBiasEnable = VK_FALSE;
+    infos.raster.depthBiasConstantFactor = 0.0f;
+    infos.raster.depthBiasClamp = 0.0f;
+    infos.raster.depthBiasSlopeFactor = 0.0f;
+
+    // multisampling
+    infos.multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    infos.multisample.sampleShadingEnable = VK_FALSE;
+    infos.multisample.rasterizationSamples = desc.samples;
+    infos.multisample.minSampleShading = 1.0f; // Optional
+    infos.multisample.pSampleMask = nullptr; // Optional
+    infos.multisample.alphaToCoverageEnable = VK_FALSE; // Optional
+    infos.multisample.alphaToOneEnable = VK_FALSE; // Optional
+
+    // color blending
+    infos.colorBlendAttachment.colorWriteMask = desc.colorWriteMask;
+    infos.colorBlendAttachment.blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+    infos.colorBlendAttachment.srcColorBlendFactor = desc.srcColorBlendFactor;
+    infos.colorBlendAttachment.dstColorBlendFactor = desc.dstColorBlendFactor;
+    infos.colorBlendAttachment.colorBlendOp = desc.colorBlendOp;
+    infos.colorBlendAttachment.srcAlphaBlendFactor = desc.srcAlphaBlendFactor;
+    infos.colorBlendAttachment.dstAlphaBlendFactor = desc.dstAlphaBlendFactor;
+    infos.colorBlendAttachment.alphaBlendOp = desc.alphaBlendOp;
+
+    infos.colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    infos.colorBlend.logicOpEnable = VK_FALSE;
+    infos.colorBlend.logicOp = VK_LOGIC_OP_COPY; // Optional
+    infos.colorBlend.attachmentCount = 1;
+    infos.colorBlend.pAttachments = &infos.colorBlendAttachment;
+    infos.colorBlend.blendConstants[0] = 0.0f; // Optional
+    infos.colorBlend.blendConstants[1] = 0.0f; // Optional
+    infos.colorBlend.blendConstants[2] = 0.0f; // Optional
+    infos.colorBlend.blendConstants[3] = 0.0f; // Optional
+
+    // dynamic state
+    infos.dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    infos.dynamicState.dynamicStateCount = static_cast<uint32_t>(
+      desc.dynamicStates.size()
+    );
+    infos.dynamicState.pDynamicStates = desc.dynamicStates.data();
+
+    // dynamic rendering, the pipeline only knows the attachment formats
+    infos.rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+    infos.rendering.colorAttachmentCount = 1;
+    infos.rendering.pColorAttachmentFormats = &desc.colorFormat;
+  }
+
+  // packs the constants into one 32-bit slot each, nullptr when there are none
+  const VkSpecializationInfo* fillSpecializationInfo(
+    const std::vector<SpecializationConstant>& constants,
+    std::vector<VkSpecializationMapEntry>& entries,
+    std::vector<uint32_t>& data,
+    VkSpecializationInfo& info
+  ) {
+    if (constants.empty()) {
+      return nullptr;
+    }
+
+    for (const SpecializationConstant& constant : constants) {
+      VkSpecializationMapEntry entry{};
+      entry.constantID = constant.constantId;
+      entry.offset = static_cast<uint32_t>(data.size() * sizeof(uint32_t));
+      entry.size = sizeof(uint32_t);
+
+      entries.push_back(entry);
+      data.push_back(constant.value);
+    }
+
+    info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    info.pMapEntries = entries.data();
+    info.dataSize = data.size() * sizeof(uint32_t);
+    info.pData = data.data();
+
+    return &info;
+  }
+
+  // the modules are only needed while the pipeline is created
+  void destroyShaderModules(PipelineStateInfos& infos) {
+    if (infos.vertModule != VK_NULL_HANDLE) {
+      vkDestroyShaderModule(m_logicalDevice, infos.vertModule, nullptr);
+    }
+    if (infos.fragModule != VK_NULL_HANDLE) {
+      vkDestroyShaderModule(m_logicalDevice, infos.fragModule, nullptr);
+    }
+  }
+
+  VkPipeline buildGraphicsPipeline(const GraphicsPipelineDesc& desc) {
+    if (m_pipelineLibrariesEnabled) {
+      return linkGraphicsPipeline(desc);
+    }
+
+    PipelineStateInfos infos;
+    fillPipelineStateInfos(desc, infos, true, true);
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = {
+      infos.vertStage,
+      infos.fragStage
+    };
+
+    // graphics pipeline
+    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+    graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+
+    if (desc.renderPass == VK_NULL_HANDLE) {
+      graphicsPipelineCreateInfo.pNext = &infos.rendering;
+    }
+
+    graphicsPipelineCreateInfo.stageCount = 2;
+    graphicsPipelineCreateInfo.pStages = shaderStages;
+
+    graphicsPipelineCreateInfo.pVertexInputState = &infos.vertexInput;
+    graphicsPipelineCreateInfo.pInputAssemblyState = &infos.inputAssembly;
+    graphicsPipelineCreateInfo.pViewportState = &infos.viewport;
+    graphicsPipelineCreateInfo.pRasterizationState = &infos.raster;
+    graphicsPipelineCreateInfo.pMultisampleState = &infos.multisample;
+
+    graphicsPipelineCreateInfo.pDepthStencilState = nullptr;
+    graphicsPipelineCreateInfo.pColorBlendState = &infos.colorBlend;
+    graphicsPipelineCreateInfo.pDynamicState = &infos.dynamicState;
+
+    graphicsPipelineCreateInfo.layout = desc.layout;
+    graphicsPipelineCreateInfo.renderPass = desc.renderPass;
+    graphicsPipelineCreateInfo.subpass = desc.subpass;
+
+    graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    graphicsPipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(
+      m_logicalDevice, m_pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline
+    );
+
+    destroyShaderModules(infos);
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_GRAPHICS_PIPELINE");
+    }
+
+    return pipeline;
+  }
+
+  // the part of a description a pipeline library depends on, everything
+  // else is left at its default so equal parts share one library
+  GraphicsPipelineDesc pipelineLibraryKey(
+    const GraphicsPipelineDesc& desc,
+    PipelineLibraryPart part
+  ) {
+    GraphicsPipelineDesc key{};
+    key.dynamicStates = desc.dynamicStates;
+
+    switch (part) {
+      case PipelineLibraryPart::VERTEX_INPUT:
+        key.vertexBindings = desc.vertexBindings;
+        key.vertexAttributes = desc.vertexAttributes;
+        key.topology = desc.topology;
+        break;
+      case PipelineLibraryPart::PRE_RASTERIZATION:
+        key.vertShaderPath = desc.vertShaderPath;
+        key.shaderRevision = desc.shaderRevision;
+        key.vertSpecialization = desc.vertSpecialization;
+        key.polygonMode = desc.polygonMode;
+        key.cullMode = desc.cullMode;
+        key.frontFace = desc.frontFace;
+        key.renderPass = desc.renderPass;
+        key.subpass = desc.subpass;
+        key.layout = desc.layout;
+        break;
+      case PipelineLibraryPart::FRAGMENT_SHADER:
+        key.fragShaderPath = desc.fragShaderPath;
+        key.shaderRevision = desc.shaderRevision;
+        key.fragSpecialization = desc.fragSpecialization;
+        key.samples = desc.samples;
+        key.renderPass = desc.renderPass;
+        key.subpass = desc.subpass;
+        key.layout = desc.layout;
+        break;
+      case PipelineLibraryPart::FRAGMENT_OUTPUT:
+        key.blendEnable = desc.blendEnable;
+        key.srcColorBlendFactor = desc.srcColorBlendFactor;
+        key.dstColorBlendFactor = desc.dstColorBlendFactor;
+        key.colorBlendOp = desc.colorBlendOp;
+        key.srcAlphaBlendFactor = desc.srcAlphaBlendFactor;
+        key.dstAlphaBlendFactor = desc.dstAlphaBlendFactor;
+        key.alphaBlendOp = desc.alphaBlendOp;
+        key.colorWriteMask = desc.colorWriteMask;
+        key.samples = desc.samples;
+        key.colorFormat = desc.colorFormat;
+        key.renderPass = desc.renderPass;
+        key.subpass = desc.subpass;
+        break;
+    }
+
+    key.rehash();
+    return key;
+  }
+
+  // compiles a part once and shares it between every pipeline using it,
+  // callable from the compile workers
+  VkPipeline getPipelineLibrary(
+    const GraphicsPipelineDesc& desc,
+    PipelineLibraryPart part
+  ) {
+    GraphicsPipelineDesc key = pipelineLibraryKey(desc, part);
+    auto& libraries = m_pipelineLibraries[static_cast<size_t>(part)];
+
+    {
+      std::lock_guard<std::mutex> lock(m_pipelineLibraryMutex);
+      auto cached = libraries.find(key);
+      if (cached != libraries.end()) {
+        return cached->second;
+      }
+    }
+
+    // compiled outside the lock, a worker that lost the race throws its
+    // library away again
+    VkPipeline library = buildPipelineLibrary(desc, part);
+
+    std::lock_guard<std::mutex> lock(m_pipelineLibraryMutex);
+    auto [entry, inserted] = libraries.emplace(key, library);
+    if (!inserted) {
+      vkDestroyPipeline(m_logicalDevice, library, nullptr);
+    }
+
+    return entry->second;
+  }
+
+  VkPipeline buildPipelineLibrary(
+    const GraphicsPipelineDesc& desc,
+    PipelineLibraryPart part
+  ) {
+    PipelineStateInfos infos;
+    fillPipelineStateInfos(
+      desc, infos,
+      part == PipelineLibraryPart::PRE_RASTERIZATION,
+      part == PipelineLibraryPart::FRAGMENT_SHADER
+    );
+
+    VkGraphicsPipelineLibraryCreateInfoEXT libraryCreateInfo{};
+    libraryCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+
+    if (desc.renderPass == VK_NULL_HANDLE) {
+      libraryCreateInfo.pNext = &infos.rendering;
+    }
+
+    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+    graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    graphicsPipelineCreateInfo.pNext = &libraryCreateInfo;
+    graphicsPipelineCreateInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+    graphicsPipelineCreateInfo.pDynamicState = &infos.dynamicState;
+    graphicsPipelineCreateInfo.basePipelineIndex = -1;
+
+    // each part only gets the state it is made of
+    switch (part) {
+      case PipelineLibraryPart::VERTEX_INPUT:
+        libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+        graphicsPipelineCreateInfo.pVertexInputState = &infos.vertexInput;
+        graphicsPipelineCreateInfo.pInputAssemblyState = &infos.inputAssembly;
+        break;
+      case PipelineLibraryPart::PRE_RASTERIZATION:
+        libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+        graphicsPipelineCreateInfo.stageCount = 1;
+        graphicsPipelineCreateInfo.pStages = &infos.vertStage;
+        graphicsPipelineCreateInfo.pViewportState = &infos.viewport;
+        graphicsPipelineCreateInfo.pRasterizationState = &infos.raster;
+        graphicsPipelineCreateInfo.layout = desc.layout;
+        graphicsPipelineCreateInfo.renderPass = desc.renderPass;
+        graphicsPipelineCreateInfo.subpass = desc.subpass;
+        break;
+      case PipelineLibraryPart::FRAGMENT_SHADER:
+        libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+        graphicsPipelineCreateInfo.stageCount = 1;
+        graphicsPipelineCreateInfo.pStages = &infos.fragStage;
+        graphicsPipelineCreateInfo.pMultisampleState = &infos.multisample;
+        graphicsPipelineCreateInfo.layout = desc.layout;
+        graphicsPipelineCreateInfo.renderPass = desc.renderPass;
+        graphicsPipelineCreateInfo.subpass = desc.subpass;
+        break;
+      case PipelineLibraryPart::FRAGMENT_OUTPUT:
+        libraryCreateInfo.flags = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+        graphicsPipelineCreateInfo.pMultisampleState = &infos.multisample;
+        graphicsPipelineCreateInfo.pColorBlendState = &infos.colorBlend;
+        graphicsPipelineCreateInfo.renderPass = desc.renderPass;
+        graphicsPipelineCreateInfo.subpass = desc.subpass;
+        break;
+    }
+
+    VkPipeline library;
+    VkResult result = vkCreateGraphicsPipelines(
+      m_logicalDevice, m_pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &library
+    );
+
+    destroyShaderModules(infos);
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_PIPELINE_LIBRARY");
+    }
+
+    return library;
+  }
+
+  // fast-links the four parts without link time optimization, which
+  // costs a fraction of a monolithic compile once the parts exist
+  VkPipeline linkGraphicsPipeline(const GraphicsPipelineDesc& desc) {
+    VkPipeline libraries[] = {
+      getPipelineLibrary(desc, PipelineLibraryPart::VERTEX_INPUT),
+      getPipelineLibrary(desc, PipelineLibraryPart::PRE_RASTERIZATION),
+      getPipelineLibrary(desc, PipelineLibraryPart::FRAGMENT_SHADER),
+      getPipelineLibrary(desc, PipelineLibraryPart::FRAGMENT_OUTPUT)
+    };
+
+    VkPipelineLibraryCreateInfoKHR linkInfo{};
+    linkInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+    linkInfo.libraryCount = 4;
+    linkInfo.pLibraries = libraries;
+
+    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
+    graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    graphicsPipelineCreateInfo.pNext = &linkInfo;
+    graphicsPipelineCreateInfo.layout = desc.layout;
+    graphicsPipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(
+      m_logicalDevice, m_pipelineCache, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_LINK_GRAPHICS_PIPELINE");
+    }
+
+    return pipeline;
+  }
+
+  void createFramebuffers() {
+    m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
+
+    for (size_t i = 0; i < m_swapChainFramebuffers.size(); ++i) {
+      VkImageView attachments[] = {
+          m_swapChainImageViews[i]
+      };
+
+      VkFramebufferCreateInfo fbCreateInfo{};
+      fbCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+      fbCreateInfo.renderPass = m_renderPass;
+      fbCreateInfo.attachmentCount = 1;
+      fbCreateInfo.pAttachments = attachments;
+      fbCreateInfo.width = m_swapChainExtent.width;
+      fbCreateInfo.height = m_swapChainExtent.height;
+      fbCreateInfo.layers = 1;
+
+      VkResult result = vkCreateFramebuffer(
+        m_logicalDevice, &fbCreateInfo, nullptr, &m_swapChainFramebuffers[i]
+      );
+
+      if (result != VK_SUCCESS) {
+        throw std::runtime_error("ERROR_FAIL_CREATE_FRAMEBUFFER");
+      }
+    }
+  }
+
+  void createCommandPool() {
+    const QueueFamilyIndices& indices = m_capabilities.queueFamilyIndices;
+
+    VkCommandPoolCreateInfo cmdPoolCreateInfo{};
+    cmdPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    cmdPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    cmdPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+
+    VkResult result = vkCreateCommandPool(
+      m_logicalDevice, &cmdPoolCreateInfo, nullptr, &m_commandPool
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_COMMAND_POOL");
     }
+  }
 
-    // proceed with creating the logical device
-    VkResult result = vkCreateDevice(
-      m_physicalDevice, &devCreateInfo, nullptr, &m_logicalDevice
+  void createCommandBuffers() {
+    m_commandBuffers.resize(m_settings.framesInFlight);
+
+    VkCommandBufferAllocateInfo cmdBuffAllocInfo{};
+    cmdBuffAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBuffAllocInfo.commandPool = m_commandPool;
+    cmdBuffAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBuffAllocInfo.commandBufferCount = static_cast<uint32_t>(
+      m_commandBuffers.size()
+    );
+
+    VkResult result = vkAllocateCommandBuffers(
+      m_logicalDevice, &cmdBuffAllocInfo, m_commandBuffers.data()
     );
 
     if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_LOGICAL_DEVICE_CREATE_FAIL");
+      throw std::runtime_error("ERROR_FAIL_CREATE_COMMAND_BUFFER");
     }
+  }
 
-    // initialize device queue
-    vkGetDeviceQueue(
-      m_logicalDevice,
-      indices.graphicsFamily.value(),
-      0,
-      &m_graphicsQueue
+  void createSyncObjects() {
+    VkSemaphoreCreateInfo semCreateInfo{};
+    semCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fenceCreateInfo{};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    m_imageAvailableSemaphores.resize(m_settings.framesInFlight);
+    m_frameSlotNumbers.resize(m_settings.framesInFlight, 0);
+
+    for (uint32_t i = 0; i < m_settings.framesInFlight; ++i) {
+      if (
+        vkCreateSemaphore(m_logicalDevice, &semCreateInfo, nullptr, &m_imageAvailableSemaphores[i]) != VK_SUCCESS
+      ) {
+        throw std::runtime_error("ERROR_FAIL_SYNC_OBJECTS_CREATE");
+      }
+    }
+
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      VkSemaphoreTypeCreateInfo timelineCreateInfo{};
+      timelineCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+      timelineCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+      timelineCreateInfo.initialValue = 0;
+
+      VkSemaphoreCreateInfo timelineSemCreateInfo{};
+      timelineSemCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      timelineSemCreateInfo.pNext = &timelineCreateInfo;
+
+      if (
+        vkCreateSemaphore(m_logicalDevice, &timelineSemCreateInfo, nullptr, &m_frameTimeline) != VK_SUCCESS
+      ) {
+        throw std::runtime_error("ERROR_FAIL_SYNC_OBJECTS_CREATE");
+      }
+    } else {
+      m_inFlightFences.resize(m_settings.framesInFlight);
+
+      for (uint32_t i = 0; i < m_settings.framesInFlight; ++i) {
+        if (
+          vkCreateFence(m_logicalDevice, &fenceCreateInfo, nullptr, &m_inFlightFences[i]) != VK_SUCCESS
+        ) {
+          throw std::runtime_error("ERROR_FAIL_SYNC_OBJECTS_CREATE");
+        }
+      }
+    }
+
+  }
+
+  void createRenderFinishedSemaphores() {
+    VkSemaphoreCreateInfo semCreateInfo{};
+    semCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    m_renderFinishedSemaphores.resize(m_swapChainImages.size());
+
+    for (size_t i = 0; i < m_swapChainImages.size(); ++i) {
+      if (
+        vkCreateSemaphore(m_logicalDevice, &semCreateInfo, nullptr, &m_renderFinishedSemaphores[i]) != VK_SUCCESS
+      ) {
+        throw std::runtime_error("ERROR_FAIL_SYNC_OBJECTS_CREATE");
+      }
+    }
+  }
+
+  void recreateSwapChain() {
+    // a minimized window has no framebuffer, wait until it comes back
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(m_window, &width, &height);
+    while (width == 0 || height == 0) {
+      glfwWaitEvents();
+      glfwGetFramebufferSize(m_window, &width, &height);
+    }
+
+    VkSwapchainKHR oldSwapChain = m_vkSwapChain;
+    std::vector<VkImageView> oldImageViews = std::move(m_swapChainImageViews);
+    std::vector<VkFramebuffer> oldFramebuffers = std::move(m_swapChainFramebuffers);
+    std::vector<VkSemaphore> oldRenderFinishedSemaphores = std::move(
+      m_renderFinishedSemaphores
     );
-    vkGetDeviceQueue(
-      m_logicalDevice,
-      indices.presentationFamily.value(),
-      0,
-      &m_presentationQueue
+
+    // present ids belong to the old swapchain
+    if (m_presentWaitEnabled) {
+      m_pendingLatencies.clear();
+    }
+
+    VkFormat oldFormat = m_swapChainImageFormat;
+    createSwapChain(oldSwapChain);
+    createImageViews();
+
+    // the surface may prefer another format now, such as after the window
+    // moved to an HDR display; the framebuffers need the new render pass
+    if (m_swapChainImageFormat != oldFormat) {
+      rebuildForSwapChainFormat();
+    }
+
+    if (!m_dynamicRenderingEnabled) {
+      createFramebuffers();
+    }
+    createRenderFinishedSemaphores();
+
+    if (isCaptureEnabled()) {
+      resizeReadbackRing();
+    }
+
+    // instead of idling the device, the old objects go away once the
+    // first frame rendered into the new swapchain retires; by then the
+    // old images were either presented or released by the new swapchain
+    deferDestroy(
+      m_submittedFrame + 1,
+      [
+        this,
+        oldSwapChain,
+        oldImageViews,
+        oldFramebuffers,
+        oldRenderFinishedSemaphores
+      ]() {
+        for (VkFramebuffer framebuffer : oldFramebuffers) {
+          vkDestroyFramebuffer(m_logicalDevice, framebuffer, nullptr);
+        }
+
+        for (VkImageView imageView : oldImageViews) {
+          vkDestroyImageView(m_logicalDevice, imageView, nullptr);
+        }
+
+        for (VkSemaphore semaphore : oldRenderFinishedSemaphores) {
+          vkDestroySemaphore(m_logicalDevice, semaphore, nullptr);
+        }
+
+        vkDestroySwapchainKHR(m_logicalDevice, oldSwapChain, nullptr);
+      }
     );
   }
 
-  void createSwapChain() {
-    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_physicalDevice);
+  // everything built for the old color format is incompatible with the new
+  // one, so unlike a variant change there is no fallback to draw with;
+  // the frames go out without the triangle until its new pipeline compiles
+  void rebuildForSwapChainFormat() {
+    std::cout << "SWAPCHAIN_FORMAT_CHANGED: " << m_swapChainImageFormat
+      << ", rebuilding the render pass and pipelines" << '\n';
 
-    VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-    VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-    VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
+    if (isCaptureEnabled() && !isCaptureFormatBgra(m_swapChainImageFormat).has_value()) {
+      throw std::runtime_error("ERROR_UNSUPPORTED_CAPTURE_FORMAT");
+    }
 
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-    if (
-      swapChainSupport.capabilities.maxImageCount > 0 &&
-      imageCount > swapChainSupport.capabilities.maxImageCount
-    ) {
-        imageCount = swapChainSupport.capabilities.maxImageCount;
+    if (!m_dynamicRenderingEnabled) {
+      VkRenderPass oldRenderPass = m_renderPass;
+      deferDestroy(m_submittedFrame, [this, oldRenderPass]() {
+        vkDestroyRenderPass(m_logicalDevice, oldRenderPass, nullptr);
+      });
+      createRenderPass();
     }
 
-    VkSwapchainCreateInfoKHR createInfo{};
-    createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    createInfo.surface = m_vkSurface;
+    m_trianglePipelineDesc.colorFormat = m_swapChainImageFormat;
+    m_trianglePipelineDesc.renderPass = m_renderPass;
 
-    createInfo.minImageCount = imageCount;
-    createInfo.imageFormat = surfaceFormat.format;
-    createInfo.imageColorSpace = surfaceFormat.colorSpace;
-    createInfo.imageExtent = extent;
-    createInfo.imageArrayLayers = 1;
-    createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // shader objects do not depend on the color format
+    if (m_shaderObjectsEnabled) {
+      return;
+    }
 
-    QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
-    uint32_t queueFamilyIndices[] = {
-      indices.graphicsFamily.value(),
-      indices.presentationFamily.value()
+    // retired by retireStalePipelines() like the ones of a reload
+    for (auto it = m_pipelineVariants.begin(); it != m_pipelineVariants.end();) {
+      if (it->first.colorFormat == m_swapChainImageFormat) {
+        ++it;
+        continue;
+      }
+
+      m_stalePipelines.push_back(it->second);
+      it = m_pipelineVariants.erase(it);
+    }
+
+    m_reloadPending = false;
+    m_fallbackPipeline = VK_NULL_HANDLE;
+    m_graphicsPipeline = requestGraphicsPipeline(m_trianglePipelineDesc);
+  }
+
+  void startShaderHotReload() {
+    m_hotReloadEnabled = m_shaderWatcher.start("shaders");
+
+    std::cout << "HOT_RELOAD: " << (
+      m_hotReloadEnabled ? "watching shaders/" : "unsupported, shaders stay as loaded"
+    ) << '\n';
+  }
+
+  // runs at the frame boundary: starts recompiles for edited sources and
+  // swaps in the shaders of the ones that finished
+  void pollShaderHotReload() {
+    for (const std::string& source : m_shaderWatcher.poll()) {
+      // other files may come and go in shaders/, only ours are compiled
+      if (hotReloadShaders.count(source) == 0) {
+        continue;
+      }
+
+      m_shaderRecompiles.push_back(recompileShader(source));
+    }
+
+    bool recompiled = false;
+    for (auto it = m_shaderRecompiles.begin(); it != m_shaderRecompiles.end();) {
+      if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ++it;
+        continue;
+      }
+
+      recompiled = recompiled || it->get();
+      it = m_shaderRecompiles.erase(it);
+    }
+
+    if (recompiled) {
+      reloadTriangleShaders();
+    }
+  }
+
+  // shaders/shader.<stage> compiles to shaders/<stage>.spv, the layout
+  // compile_shaders.sh uses; the rename keeps loads from seeing half a file.
+  // With runtime shaders the compile only warms the compiler's cache
+  std::shared_future<bool> recompileShader(const std::string& source) {
+    std::string output = "shaders/" + hotReloadShaders.at(source);
+
+    auto promise = std::make_shared<std::promise<bool>>();
+    std::shared_future<bool> future = promise->get_future().share();
+
+    ShaderCompiler* shaderCompiler = m_shaderCompiler.get();
+    auto compile = [source, output, promise, shaderCompiler]() {
+      bool compiled = false;
+      if (shaderCompiler != nullptr) {
+        try {
+          shaderCompiler->compile("shaders/" + source);
+          compiled = true;
+        } catch (const std::exception& error) {
+          std::cerr << error.what() << '\n';
+        }
+      } else {
+        compiled = (
+          runProgram({"glslc", "shaders/" + source, "-o", output + ".tmp"}) &&
+          std::rename((output + ".tmp").c_str(), output.c_str()) == 0
+        );
+      }
+
+      std::cout << "HOT_RELOAD: " << source << (
+        compiled ? " recompiled" : " failed to compile, keeping the old shader"
+      ) << '\n';
+      promise->set_value(compiled);
     };
 
-    if (indices.graphicsFamily != indices.presentationFamily) {
-        createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-        createInfo.queueFamilyIndexCount = 2;
-        createInfo.pQueueFamilyIndices = queueFamilyIndices;
+    if (m_pipelineCompiler.isRunning()) {
+      m_pipelineCompiler.submit(compile);
     } else {
-        createInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        // createInfo.queueFamilyIndexCount = 0; // Optional
-        // createInfo.pQueueFamilyIndices = nullptr; // Optional
+      compile();
     }
 
-    createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
-    createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    createInfo.presentMode = presentMode;
-    createInfo.clipped = VK_TRUE;
+    return future;
+  }
+
+  // requests the triangle with the new SPIR-V, the old pipeline keeps
+  // drawing until it is compiled, or for good if it fails to build
+  void reloadTriangleShaders() {
+    // a fresh revision even when this reload fails, so nothing built from
+    // the broken SPIR-V is ever picked up by a later one
+    ++m_shaderRevision;
+    GraphicsPipelineDesc desc = m_trianglePipelineDesc;
+    desc.shaderRevision = m_shaderRevision;
+
+    try {
+      // an edit may have changed the shaders' interface
+      reflectPipelineLayout(desc);
+
+      // created right away, before the old ones are retired below
+      if (m_shaderObjectsEnabled) {
+        getShaderObject(desc, VK_SHADER_STAGE_VERTEX_BIT);
+        getShaderObject(desc, VK_SHADER_STAGE_FRAGMENT_BIT);
+      }
+    } catch (const std::exception& error) {
+      std::cerr << error.what() << '\n';
+      std::cout << "HOT_RELOAD: reload failed, keeping the old shaders" << '\n';
+      return;
+    }
 
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    m_trianglePipelineDesc = desc;
 
-    VkResult result = vkCreateSwapchainKHR(
-      m_logicalDevice, &createInfo, nullptr, &m_vkSwapChain
-    );
+    for (auto it = m_pipelineVariants.begin(); it != m_pipelineVariants.end();) {
+      if (it->first.shaderRevision == m_shaderRevision) {
+        ++it;
+        continue;
+      }
 
-    if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAIL_CREATE_SWAPCHAIN");
+      m_stalePipelines.push_back(it->second);
+      it = m_pipelineVariants.erase(it);
     }
 
-    vkGetSwapchainImagesKHR(
-      m_logicalDevice, m_vkSwapChain, &imageCount, nullptr
-    );
-    m_swapChainImages.resize(imageCount);
+    // shader objects are created right away, so the old ones are
+    // unused from the next recorded frame on
+    for (auto it = m_shaderObjects.begin(); it != m_shaderObjects.end();) {
+      if (it->first.shaderRevision == m_shaderRevision) {
+        ++it;
+        continue;
+      }
 
-    vkGetSwapchainImagesKHR(
-      m_logicalDevice, m_vkSwapChain, &imageCount, m_swapChainImages.data()
-    );
+      VkShaderEXT shader = it->second;
+      deferDestroy(m_submittedFrame, [this, shader]() {
+        m_shaderObjectFunctions.destroyShader(m_logicalDevice, shader, nullptr);
+      });
+      it = m_shaderObjects.erase(it);
+    }
 
-    m_swapChainImageFormat = surfaceFormat.format;
-    m_swapChainExtent = extent;
+    m_reloadPending = !m_shaderObjectsEnabled;
+    requestTriangleVariant();
   }
 
-  void createImageViews() {
-    m_swapChainImageViews.resize(m_swapChainImages.size());
+  // once the reloaded pipeline draws, the stale ones only wait for the
+  // frames already submitted with them; while one of them still draws in
+  // place of a failed reload, they all stay
+  void retireStalePipelines() {
+    if (m_stalePipelines.empty()) {
+      return;
+    }
 
-    for (size_t i = 0; i < m_swapChainImages.size(); ++i) {
-      VkImageViewCreateInfo createInfo{};
-      createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-      createInfo.image = m_swapChainImages[i];
-      createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-      createInfo.format = m_swapChainImageFormat;
+    if (
+      m_reloadPending &&
+      m_graphicsPipeline.wait_for(std::chrono::seconds(0)) == std::future_status::ready
+    ) {
+      // a failed build is taken care of by currentTrianglePipeline()
+      currentTrianglePipeline();
 
-      createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-      createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-      createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-      createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+      if (m_reloadPending) {
+        m_reloadPending = false;
+        m_fallbackPipeline = VK_NULL_HANDLE;
+      }
+    }
 
-      createInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-      createInfo.subresourceRange.baseMipLevel = 0;
-      createInfo.subresourceRange.levelCount = 1;
-      createInfo.subresourceRange.baseArrayLayer = 0;
-      createInfo.subresourceRange.layerCount = 1;
+    if (m_reloadPending || m_fallbackPipeline != VK_NULL_HANDLE) {
+      return;
+    }
 
-      VkResult result = vkCreateImageView(
-        m_logicalDevice, &createInfo, nullptr, &m_swapChainImageViews[i]
-      );
+    for (auto it = m_stalePipelines.begin(); it != m_stalePipelines.end();) {
+      if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        ++it;
+        continue;
+      }
 
-      if (result != VK_SUCCESS) {
-        throw std::runtime_error("ERROR_FAIL_CREATE_IMAGE_VIEW");
+      try {
+        VkPipeline pipeline = it->get();
+        deferDestroy(m_submittedFrame, [this, pipeline]() {
+          vkDestroyPipeline(m_logicalDevice, pipeline, nullptr);
+        });
+      } catch (const std::exception&) {
+        // failed compiles have nothing to destroy
+      }
+      it = m_stalePipelines.erase(it);
+    }
+
+    // no compile of a stale pipeline is left to link their libraries
+    if (m_stalePipelines.empty()) {
+      retirePipelineLibraries();
+    }
+  }
+
+  // libraries live as long as a cached variant is made of them, the
+  // ones of replaced shaders, layouts or vertex inputs go with it
+  void retirePipelineLibraries() {
+    if (!m_pipelineLibrariesEnabled) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_pipelineLibraryMutex);
+
+    for (size_t part = 0; part < std::size(m_pipelineLibraries); ++part) {
+      std::unordered_set<GraphicsPipelineDesc, GraphicsPipelineDescHash> used;
+      for (const auto& [desc, future] : m_pipelineVariants) {
+        used.insert(pipelineLibraryKey(desc, static_cast<PipelineLibraryPart>(part)));
+      }
+
+      auto& libraries = m_pipelineLibraries[part];
+      for (auto it = libraries.begin(); it != libraries.end();) {
+        if (used.count(it->first) > 0) {
+          ++it;
+          continue;
+        }
+
+        VkPipeline library = it->second;
+        deferDestroy(m_submittedFrame, [this, library]() {
+          vkDestroyPipeline(m_logicalDevice, library, nullptr);
+        });
+        it = libraries.erase(it);
       }
     }
   }
 
-  void createRenderPass() {
-    // attachment description
-    VkAttachmentDescription colorAttachment{};
-    colorAttachment.format = m_swapChainImageFormat;
-    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  void deferDestroy(uint64_t frameNumber, std::function<void()> destroy) {
+    m_deletionQueue.push_back({frameNumber, std::move(destroy)});
+  }
 
-    // subpasses and attachment references
-    VkAttachmentReference colorAttachmentRef{};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  // runs the queued destroys whose frame has retired
+  void collectDeferredDestroys() {
+    if (m_deletionQueue.empty()) {
+      return;
+    }
 
-    VkSubpassDescription subpassDescription{};
-    subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpassDescription.colorAttachmentCount = 1;
-    subpassDescription.pColorAttachments = &colorAttachmentRef;
+    uint64_t retired = retiredFrame();
+    while (
+      !m_deletionQueue.empty() &&
+      m_deletionQueue.front().frameNumber <= retired
+    ) {
+      m_deletionQueue.front().destroy();
+      m_deletionQueue.pop_front();
+    }
+  }
 
-    VkSubpassDependency subpassDependency{};
-    subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    subpassDependency.dstSubpass = 0;
-    subpassDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.srcAccessMask = 0;
-    subpassDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpassDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  bool isCaptureEnabled() {
+    return !m_settings.captureDir.empty() || m_settings.keepLastFrame;
+  }
 
-    // render pass
-    VkRenderPassCreateInfo renderPassCreateInfo{};
-    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassCreateInfo.attachmentCount = 1;
-    renderPassCreateInfo.pAttachments = &colorAttachment;
-    renderPassCreateInfo.subpassCount = 1;
-    renderPassCreateInfo.pSubpasses = &subpassDescription;
-    renderPassCreateInfo.dependencyCount = 1;
-    renderPassCreateInfo.pDependencies = &subpassDependency;
+  // the formats writeCapture() knows how to turn into RGB
+  static std::optional<bool> isCaptureFormatBgra(VkFormat format) {
+    switch (format) {
+      case VK_FORMAT_B8G8R8A8_UNORM:
+      case VK_FORMAT_B8G8R8A8_SRGB:
+        return true;
+      case VK_FORMAT_R8G8B8A8_UNORM:
+      case VK_FORMAT_R8G8B8A8_SRGB:
+        return false;
+      default:
+        return std::nullopt;
+    }
+  }
+
+  void createReadbackRing() {
+    if (!isCaptureEnabled()) {
+      return;
+    }
+
+    // fail before the first frame rather than at the first capture
+    if (!isCaptureFormatBgra(m_swapChainImageFormat).has_value()) {
+      throw std::runtime_error("ERROR_UNSUPPORTED_CAPTURE_FORMAT");
+    }
+
+    // sized for the current extent, recreateSwapChain() resizes them
+    m_readbackRing.resize(m_settings.framesInFlight);
+    for (ReadbackBuffer& readback : m_readbackRing) {
+      createReadbackBuffer(readback, readbackSize());
+    }
+
+    // a few frames of slack for the disk, beyond that frames are dropped
+    if (!m_settings.captureDir.empty()) {
+      m_captureWriter.start(
+        m_settings.captureDir, m_settings.captureFormat, m_settings.framesInFlight * 2
+      );
+    }
+  }
+
+  void createReadbackBuffer(ReadbackBuffer& readback, VkDeviceSize size) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkResult result = vkCreateBuffer(
+      m_logicalDevice, &bufferInfo, nullptr, &readback.buffer
+    );
+
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_CREATE_READBACK_BUFFER");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_logicalDevice, readback.buffer, &memRequirements);
+
+    // cached memory makes the CPU reads fast, coherent spares us the
+    // invalidate; fall back to uncached where the driver has no such type
+    std::optional<uint32_t> memoryType = queryMemoryType(
+      memRequirements.memoryTypeBits,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
+      VK_MEMORY_PROPERTY_HOST_CACHED_BIT
+    );
 
-    VkResult result = vkCreateRenderPass(
-      m_logicalDevice, &renderPassCreateInfo, nullptr, &m_renderPass
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = memoryType.has_value() ? memoryType.value() : (
+      findMemoryType(
+        memRequirements.memoryTypeBits,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+      )
     );
 
+    result = vkAllocateMemory(m_logicalDevice, &allocInfo, nullptr, &readback.memory);
+
     if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAIL_CREATE_RENDER_PASS");
+      throw std::runtime_error("ERROR_FAIL_ALLOCATE_READBACK_MEMORY");
     }
 
-  }
-
-  void createGraphicsPipeline() {
-    // obtain shaders SPIR-V code
-    auto vertShaderCode = readFile("shaders/vert.spv");
-    auto fragShaderCode = readFile("shaders/frag.spv");
+    vkBindBufferMemory(m_logicalDevice, readback.buffer, readback.memory, 0);
 
-    // create shader modules
-    VkShaderModule vertModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragModule = createShaderModule(fragShaderCode);
+    // stays mapped for the lifetime of the buffer
+    result = vkMapMemory(m_logicalDevice, readback.memory, 0, size, 0, &readback.mapped);
 
-    // create shaders stages
-    VkPipelineShaderStageCreateInfo vertStageCreateInfo{};
-    vertStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertStageCreateInfo.module = vertModule;
-    vertStageCreateInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragStageCreateInfo{};
-    fragStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragStageCreateInfo.module = fragModule;
-    fragStageCreateInfo.pName = "main";
+    if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_MAP_READBACK_MEMORY");
+    }
 
-    VkPipelineShaderStageCreateInfo shaderStages[] = {
-      vertStageCreateInfo,
-      fragStageCreateInfo
-    };
+    readback.size = size;
+  }
 
-    // vertext input
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertexInputInfo.vertexBindingDescriptionCount = 0;
-    vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
-    vertexInputInfo.vertexAttributeDescriptionCount = 0;
-    vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
+  void destroyReadbackBuffer(ReadbackBuffer& readback) {
+    if (readback.buffer == VK_NULL_HANDLE) {
+      return;
+    }
 
-    // input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo{};
-    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+    vkUnmapMemory(m_logicalDevice, readback.memory);
+    vkDestroyBuffer(m_logicalDevice, readback.buffer, nullptr);
+    vkFreeMemory(m_logicalDevice, readback.memory, nullptr);
 
-    // viewport
-    VkViewport viewport{};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = (float) m_swapChainExtent.width;
-    viewport.height = (float) m_swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
+    readback = {};
+  }
 
-    // scissors
-    VkRect2D scissor{};
-    scissor.offset = {0, 0};
-    scissor.extent = m_swapChainExtent;
+  VkDeviceSize readbackSize() const {
+    return VkDeviceSize(m_swapChainExtent.width) * m_swapChainExtent.height * 4;
+  }
 
-    VkPipelineViewportStateCreateInfo viewportStateCreateInfo{};
-    viewportStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  // makes the ring fit a new swapchain extent; the replaced buffers may
+  // still be written by frames in flight, so they are written out and
+  // freed once the newest frame submitted so far has retired
+  void resizeReadbackRing() {
+    VkDeviceSize size = readbackSize();
+    std::vector<ReadbackBuffer> oldBuffers;
+
+    // oldest first, starting at the slot that is up next
+    for (uint32_t i = 0; i < m_settings.framesInFlight; ++i) {
+      ReadbackBuffer& readback = m_readbackRing[
+        (m_currentFrame + i) % m_settings.framesInFlight
+      ];
+
+      if (readback.size == size) {
+        continue;
+      }
 
-    viewportStateCreateInfo.viewportCount = 1;
-    viewportStateCreateInfo.pViewports = &viewport;
+      oldBuffers.push_back(readback);
+      readback = {};
+      createReadbackBuffer(readback, size);
+    }
 
-    viewportStateCreateInfo.scissorCount = 1;
-    viewportStateCreateInfo.pScissors = &scissor;
+    if (oldBuffers.empty()) {
+      return;
+    }
 
-    // rasterizer
-    VkPipelineRasterizationStateCreateInfo rasterStateCreateInfo{};
-    rasterStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterStateCreateInfo.depthClampEnable = VK_FALSE;
-    rasterStateCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterStateCreateInfo.lineWidth = 1.0f;
-    rasterStateCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterStateCreateInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    rasterStateCreateInfo.depthBiasEnable = VK_FALSE;
-    rasterStateCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterStateCreateInfo.depthBiasClamp = 0.0f;
-    rasterStateCreateInfo.depthBiasSlopeFactor = 0.0f;
+    deferDestroy(m_submittedFrame, [this, oldBuffers]() mutable {
+      for (ReadbackBuffer& readback : oldBuffers) {
+        writeCapture(readback);
+        destroyReadbackBuffer(readback);
+      }
+    });
+  }
 
-    // multisampling
-    VkPipelineMultisampleStateCreateInfo multisampleStateCreateInfo{};
-    multisampleStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleStateCreateInfo.sampleShadingEnable = VK_FALSE;
-    multisampleStateCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleStateCreateInfo.minSampleShading = 1.0f; // Optional
-    multisampleStateCreateInfo.pSampleMask = nullptr; // Optional
-    multisampleStateCreateInfo.alphaToCoverageEnable = VK_FALSE; // Optional
-    multisampleStateCreateInfo.alphaToOneEnable = VK_FALSE; // Optional
+  void recordReadbackCopy(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    ReadbackBuffer& readback = m_readbackRing[m_currentFrame];
+    VkImage image = m_swapChainImages[imageIndex];
 
-    // color blending
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-    VkPipelineColorBlendStateCreateInfo colorBlendStateCreateInfo{};
-    colorBlendStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlendStateCreateInfo.logicOpEnable = VK_FALSE;
-    colorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY; // Optional
-    colorBlendStateCreateInfo.attachmentCount = 1;
-    colorBlendStateCreateInfo.pAttachments = &colorBlendAttachment;
-    colorBlendStateCreateInfo.blendConstants[0] = 0.0f; // Optional
-    colorBlendStateCreateInfo.blendConstants[1] = 0.0f; // Optional
-    colorBlendStateCreateInfo.blendConstants[2] = 0.0f; // Optional
-    colorBlendStateCreateInfo.blendConstants[3] = 0.0f; // Optional
+    // the render pass leaves the image in m_colorTargetFinalLayout, which
+    // already is TRANSFER_SRC_OPTIMAL for the headless targets; its outgoing
+    // dependency made the color writes visible to the transfer stage
+    bool needsTransition = (
+      m_colorTargetFinalLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+    );
 
-    // dynamic state
-    std::vector<VkDynamicState> dynamicStates = {
-      VK_DYNAMIC_STATE_VIEWPORT,
-      VK_DYNAMIC_STATE_LINE_WIDTH
-    };
-    VkPipelineDynamicStateCreateInfo dynamicStateCreateInfo{};
-    dynamicStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-    dynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+    VkImageMemoryBarrier toTransfer{};
+    toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toTransfer.srcAccessMask = 0;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toTransfer.oldLayout = m_colorTargetFinalLayout;
+    toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toTransfer.image = image;
+    toTransfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toTransfer.subresourceRange.levelCount = 1;
+    toTransfer.subresourceRange.layerCount = 1;
+
+    if (needsTransition) {
+      m_vk.vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &toTransfer
+      );
+    }
 
-    // pipeline layout
-    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo{};
-    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = 0;
-    pipelineLayoutCreateInfo.pSetLayouts = nullptr; // Optional
-    pipelineLayoutCreateInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr; // Optional
+    // tightly packed rows, so the file writer can stream the buffer as-is
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {m_swapChainExtent.width, m_swapChainExtent.height, 1};
+
+    m_vk.vkCmdCopyImageToBuffer(
+      commandBuffer,
+      image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      readback.buffer,
+      1, &region
+    );
 
-    VkResult result = vkCreatePipelineLayout(
-      m_logicalDevice, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout
+    VkBufferMemoryBarrier toHost{};
+    toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toHost.buffer = readback.buffer;
+    toHost.offset = 0;
+    toHost.size = VK_WHOLE_SIZE;
+
+    // back to the layout presentation expects
+    VkImageMemoryBarrier toPresent = toTransfer;
+    toPresent.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    toPresent.dstAccessMask = 0;
+    toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    toPresent.newLayout = m_colorTargetFinalLayout;
+
+    m_vk.vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0, nullptr,
+      1, &toHost,
+      needsTransition ? 1u : 0u, &toPresent
     );
 
-    if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAIL_CREATE_PIPELINE_LAYOUT");
+    readback.frameNumber = m_submittedFrame + 1;
+    readback.extent = m_swapChainExtent;
+    readback.format = m_swapChainImageFormat;
+  }
+
+  // copies the retired frame out of the readback buffer, the conversion
+  // and the file write happen on the capture writer's thread
+  void writeCapture(ReadbackBuffer& readback) {
+    if (readback.frameNumber == 0) {
+      return;
     }
 
-    // graphics pipeline
-    VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{};
-    graphicsPipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    // checked against the swapchain format in createReadbackRing()
+    bool bgra = isCaptureFormatBgra(readback.format).value_or(false);
+    const char* pixels = static_cast<const char*>(readback.mapped);
+    size_t byteCount = size_t(readback.extent.width) * readback.extent.height * 4;
 
-    graphicsPipelineCreateInfo.stageCount = 2;
-    graphicsPipelineCreateInfo.pStages = shaderStages;
+    if (m_settings.keepLastFrame) {
+      m_lastFrameCapture.frameNumber = readback.frameNumber;
+      m_lastFrameCapture.extent = readback.extent;
+      m_lastFrameCapture.bgra = bgra;
+      m_lastFrameCapture.pixels.assign(pixels, pixels + byteCount);
+    }
 
-    graphicsPipelineCreateInfo.pVertexInputState = &vertexInputInfo;
-    graphicsPipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-    graphicsPipelineCreateInfo.pViewportState = &viewportStateCreateInfo;
-    graphicsPipelineCreateInfo.pRasterizationState = &rasterStateCreateInfo;
-    graphicsPipelineCreateInfo.pMultisampleState = &multisampleStateCreateInfo;
+    if (m_captureWriter.isRunning()) {
+      CaptureWriter::Frame frame;
+      frame.frameNumber = readback.frameNumber;
+      frame.extent = readback.extent;
+      frame.bgra = bgra;
+      frame.pixels = m_captureWriter.takeBuffer();
+      frame.pixels.assign(pixels, pixels + byteCount);
 
-    graphicsPipelineCreateInfo.pDepthStencilState = nullptr;
-    graphicsPipelineCreateInfo.pColorBlendState = &colorBlendStateCreateInfo;
-    graphicsPipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
+      m_captureWriter.push(std::move(frame));
+    }
 
-    graphicsPipelineCreateInfo.layout = m_pipelineLayout;
-    graphicsPipelineCreateInfo.renderPass = m_renderPass;
-    graphicsPipelineCreateInfo.subpass = 0;
+    readback.frameNumber = 0;
+  }
 
-    graphicsPipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-    graphicsPipelineCreateInfo.basePipelineIndex = -1;
+  // writes the captures still pending, the device must be idle
+  void flushReadbacks() {
+    if (!isCaptureEnabled()) {
+      return;
+    }
 
-    result = vkCreateGraphicsPipelines(
-      m_logicalDevice, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &m_graphicsPipeline
-    );
+    // buffers replaced by a resize are written by their deferred destroy,
+    // which the idle device lets run before the ring's own
+    collectDeferredDestroys();
 
-    if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAIL_CREATE_GRAPHICS_PIPELINE");
+    // oldest first, starting at the slot that is up next
+    for (uint32_t i = 0; i < m_settings.framesInFlight; ++i) {
+      writeCapture(m_readbackRing[(m_currentFrame + i) % m_settings.framesInFlight]);
     }
 
-    // destroy shaders
-    vkDestroyShaderModule(m_logicalDevice, vertModule, nullptr);
-    vkDestroyShaderModule(m_logicalDevice, fragModule, nullptr);
+    if (m_captureWriter.isRunning()) {
+      m_captureWriter.flush();
+
+      std::cout << "CAPTURED_FRAMES: " << m_captureWriter.writtenFrames()
+        << ", dropped " << m_captureWriter.droppedFrames() << '\n';
+    }
   }
 
-  void createFramebuffers() {
-    m_swapChainFramebuffers.resize(m_swapChainImageViews.size());
+  void initVulkan() {
+    std::cout << "INIT_VULKAN" << '\n';
+    StartupProfiler& profiler = m_startupProfiler;
 
-    for (size_t i = 0; i < m_swapChainFramebuffers.size(); ++i) {
-      VkImageView attachments[] = {
-          m_swapChainImageViews[i]
-      };
+    InitGraph graph;
 
-      VkFramebufferCreateInfo fbCreateInfo{};
-      fbCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-      fbCreateInfo.renderPass = m_renderPass;
-      fbCreateInfo.attachmentCount = 1;
-      fbCreateInfo.pAttachments = attachments;
-      fbCreateInfo.width = m_swapChainExtent.width;
-      fbCreateInfo.height = m_swapChainExtent.height;
-      fbCreateInfo.layers = 1;
+    // every step writes its own members, the dependencies order the reads
+    auto add = [&graph, &profiler](
+      const char* name,
+      std::vector<std::string> dependencies,
+      std::function<void()> step,
+      bool onCaller = false
+    ) {
+      graph.add(name, std::move(dependencies), [&profiler, name, step]() {
+        profiler.stage(name, step);
+      }, onCaller);
+    };
 
-      VkResult result = vkCreateFramebuffer(
-        m_logicalDevice, &fbCreateInfo, nullptr, &m_swapChainFramebuffers[i]
-      );
+    add("create_instance", {}, [this]() { createVkInstance(); });
+    add("setup_debug_messenger", {"create_instance"}, [this]() { setupDebugMessenger(); });
 
-      if (result != VK_SUCCESS) {
-        throw std::runtime_error("ERROR_FAIL_CREATE_FRAMEBUFFER");
+    // the surface and the swapchain stand in for each other when headless
+    const char* surface = "create_instance";
+    const char* swapChain = "create_offscreen_targets";
+    if (!m_settings.headless) {
+      surface = "create_surface";
+      swapChain = "create_swapchain";
+      add(surface, {"create_instance"}, [this]() { createSurface(); }, true);
+    }
+
+    // the physical device decides the optional features the later steps
+    // check, such as dynamic rendering
+    add("pick_physical_device", {surface}, [this]() { pickPhysicalDevice(); });
+    add("create_logical_device", {"pick_physical_device"}, [this]() {
+      createLogicalDevice();
+    });
+
+    if (m_settings.headless) {
+      add(swapChain, {"create_logical_device"}, [this]() { createOffscreenTargets(); });
+    } else {
+      // reads the framebuffer size through GLFW
+      add(swapChain, {"create_logical_device"}, [this]() { createSwapChain(); }, true);
+    }
+    add("create_image_views", {swapChain}, [this]() { createImageViews(); });
+    add("create_render_pass", {swapChain}, [this]() {
+      if (!m_dynamicRenderingEnabled) {
+        createRenderPass();
+      }
+    });
+
+    // overlaps with the swapchain, only the device is needed
+    add("create_pipeline_cache", {"create_logical_device"}, [this]() {
+      createPipelineCache();
+    });
+    add("prepare_shaders", {"create_logical_device"}, [this]() { prepareShaders(); });
+    add("create_command_pool", {"create_logical_device"}, [this]() { createCommandPool(); });
+    add("create_command_buffers", {"create_command_pool"}, [this]() {
+      createCommandBuffers();
+    });
+    add("create_sync_objects", {"create_logical_device"}, [this]() { createSyncObjects(); });
+    add("create_readback_ring", {swapChain}, [this]() {
+      createReadbackRing();
+    });
+
+    // only starts the pipeline compile, the compile itself is recorded
+    // separately as pipeline_compile; on the caller, since the variant
+    // cache belongs to the thread that goes on to render
+    add(
+      "create_graphics_pipeline",
+      {"prepare_shaders", "create_pipeline_cache", "create_render_pass"},
+      [this]() { createGraphicsPipeline(); },
+      true
+    );
+    add("create_framebuffers", {"create_render_pass", "create_image_views"}, [this]() {
+      if (!m_dynamicRenderingEnabled) {
+        createFramebuffers();
       }
+    });
+
+    // one per swapchain image
+    if (!m_settings.headless) {
+      add("create_render_finished_semaphores", {swapChain}, [this]() {
+        createRenderFinishedSemaphores();
+      });
     }
+
+    graph.run(m_settings.initThreads);
   }
 
-  void createCommandPool() {
-    QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+  // newest frame number whose GPU work has completed
+  uint64_t retiredFrame() {
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      m_vk.vkGetSemaphoreCounterValue(
+        m_logicalDevice, m_frameTimeline, &m_retiredFrame
+      );
+      return m_retiredFrame;
+    }
 
-    VkCommandPoolCreateInfo cmdPoolCreateInfo{};
-    cmdPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cmdPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    cmdPoolCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+    // every frame older than the ones still held by a slot has been waited
+    // on already, so only the slots with an unsignaled fence hold us back
+    uint64_t retired = m_submittedFrame;
+    for (uint32_t i = 0; i < m_settings.framesInFlight; ++i) {
+      if (
+        m_frameSlotNumbers[i] > m_retiredFrame &&
+        m_vk.vkGetFenceStatus(m_logicalDevice, m_inFlightFences[i]) != VK_SUCCESS
+      ) {
+        retired = std::min(retired, m_frameSlotNumbers[i] - 1);
+      }
+    }
 
-    VkResult result = vkCreateCommandPool(
-      m_logicalDevice, &cmdPoolCreateInfo, nullptr, &m_commandPool
-    );
+    m_retiredFrame = std::max(m_retiredFrame, retired);
+    return m_retiredFrame;
+  }
 
-    if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAIL_CREATE_COMMAND_POOL");
+  // blocks until the GPU has completed the given frame number
+  void waitForFrameRetired(uint64_t frameNumber) {
+    if (frameNumber <= m_retiredFrame) {
+      return;
     }
-  }
 
-  void createCommandBuffer() {
-    VkCommandBufferAllocateInfo cmdBuffAllocInfo{};
-    cmdBuffAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBuffAllocInfo.commandPool = m_commandPool;
-    cmdBuffAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBuffAllocInfo.commandBufferCount = 1;
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      VkSemaphoreWaitInfo waitInfo{};
+      waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+      waitInfo.semaphoreCount = 1;
+      waitInfo.pSemaphores = &m_frameTimeline;
+      waitInfo.pValues = &frameNumber;
 
-    VkResult result = vkAllocateCommandBuffers(
-      m_logicalDevice, &cmdBuffAllocInfo, &m_commandBuffer
-    );
+      m_vk.vkWaitSemaphores(m_logicalDevice, &waitInfo, UINT64_MAX);
+      m_retiredFrame = frameNumber;
+      return;
+    }
 
-    if (result != VK_SUCCESS) {
-      throw std::runtime_error("ERROR_FAIL_CREATE_COMMAND_BUFFER");
+    // the frame either still sits in its slot or was waited on when the
+    // slot got reused, in which case m_retiredFrame already covers it
+    uint32_t slot = static_cast<uint32_t>((frameNumber - 1) % m_settings.framesInFlight);
+    if (m_frameSlotNumbers[slot] >= frameNumber) {
+      m_vk.vkWaitForFences(
+        m_logicalDevice, 1, &m_inFlightFences[slot], VK_TRUE, UINT64_MAX
+      );
+      m_retiredFrame = std::max(m_retiredFrame, m_frameSlotNumbers[slot]);
     }
   }
 
-  void createSyncObjects() {
-    VkSemaphoreCreateInfo semCreateInfo{};
-    semCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  // polled without blocking once per frame, each frame is timestamped
+  // the first time it is seen presented (or retired), so the resolution
+  // is one frame interval
+  void recordPresentLatency() {
+    uint64_t retired = m_presentWaitEnabled ? 0 : retiredFrame();
+    auto now = std::chrono::steady_clock::now();
 
-    VkFenceCreateInfo fenceCreateInfo{};
-    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    while (!m_pendingLatencies.empty()) {
+      const PendingLatency& pending = m_pendingLatencies.front();
 
-    if (
-      vkCreateSemaphore(m_logicalDevice, &semCreateInfo, nullptr, &m_imageAvailableSemaphore) != VK_SUCCESS ||
-      vkCreateSemaphore(m_logicalDevice, &semCreateInfo, nullptr, &m_renderFinishedSemaphore) != VK_SUCCESS ||
-      vkCreateFence(m_logicalDevice, &fenceCreateInfo, nullptr, &m_inFlightFence) != VK_SUCCESS
-    ) {
-      throw std::runtime_error("ERROR_FAIL_SYNC_OBJECTS_CREATE");
+      if (m_presentWaitEnabled) {
+        VkResult result = m_vk.vkWaitForPresentKHR(
+          m_logicalDevice, m_vkSwapChain, pending.frameNumber, 0
+        );
+
+        if (result == VK_TIMEOUT) {
+          break;
+        } else if (result != VK_SUCCESS) {
+          // out of date, the swapchain is about to be recreated
+          m_pendingLatencies.clear();
+          break;
+        }
+      } else if (pending.frameNumber > retired) {
+        break;
+      }
+
+      std::chrono::duration<double, std::milli> latency = now - pending.startTime;
+
+      PresentLatencyStats& stats = m_presentLatencyStats[pending.presentMode];
+      stats.frameCount++;
+      stats.totalMs += latency.count();
+      stats.maxMs = std::max(stats.maxMs, latency.count());
+
+      m_pendingLatencies.pop_front();
     }
   }
 
-  void initVulkan() {
-    std::cout << "INIT_VULKAN" << '\n';
-    createVkInstance();
-    setupDebugMessenger();
-    createSurface();
-    pickPhysicalDevice();
-    createLogicalDevice();
-    createSwapChain();
-    createImageViews();
-    createRenderPass();
-    createGraphicsPipeline();
-    createFramebuffers();
-    createCommandPool();
-    createCommandBuffer();
-    createSyncObjects();
+  void reportPresentLatency() {
+    const char* metric = m_presentWaitEnabled ? "PRESENT_LATENCY_" : "RETIRE_LATENCY_";
+
+    for (const auto& [presentMode, stats] : m_presentLatencyStats) {
+      std::cout << metric << presentModeName(presentMode) << ": "
+        << "avg " << stats.totalMs / stats.frameCount << " ms, "
+        << "max " << stats.maxMs << " ms, "
+        << stats.frameCount << " frames" << '\n';
+    }
   }
 
   void drawFrame() {
-    // wait for previous frame to be processed by the GPU
-    vkWaitForFences(m_logicalDevice, 1, &m_inFlightFence, VK_TRUE, UINT64_MAX);
-    vkResetFences(m_logicalDevice, 1, &m_inFlightFence);
+    VkCommandBuffer commandBuffer = m_commandBuffers[m_currentFrame];
+    uint64_t frameNumber = m_submittedFrame + 1;
+    auto frameStartTime = std::chrono::steady_clock::now();
+
+    // wait for the GPU to finish the frame that last used this slot,
+    // the other slots keep the GPU busy in the meantime
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      if (frameNumber > m_settings.framesInFlight) {
+        waitForFrameRetired(frameNumber - m_settings.framesInFlight);
+      }
+    } else {
+      VkFence inFlightFence = m_inFlightFences[m_currentFrame];
+      m_vk.vkWaitForFences(m_logicalDevice, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
 
-    // acquire an image from swap chain
-    uint32_t imageIndex;
-    vkAcquireNextImageKHR(
-      m_logicalDevice, m_vkSwapChain,
-      UINT64_MAX,
-      m_imageAvailableSemaphore, VK_NULL_HANDLE,
-      &imageIndex
-    );
+      m_retiredFrame = std::max(m_retiredFrame, m_frameSlotNumbers[m_currentFrame]);
+    }
+
+    if (!m_settings.headless) {
+      recordPresentLatency();
+    }
+    collectDeferredDestroys();
+
+    if (m_hotReloadEnabled) {
+      pollShaderHotReload();
+    }
+    // left behind by a reload or a swapchain format change
+    retireStalePipelines();
+
+    // the frame held by the slot has retired, its pixels can be written
+    if (isCaptureEnabled()) {
+      writeCapture(m_readbackRing[m_currentFrame]);
+    }
+
+    // acquire an image from swap chain, headless targets belong to the slot
+    uint32_t imageIndex = m_currentFrame;
+    VkResult result = VK_SUCCESS;
+
+    if (!m_settings.headless) {
+      result = m_vk.vkAcquireNextImageKHR(
+        m_logicalDevice, m_vkSwapChain,
+        UINT64_MAX,
+        m_imageAvailableSemaphores[m_currentFrame], VK_NULL_HANDLE,
+        &imageIndex
+      );
+
+      if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        recreateSwapChain();
+        return;
+      } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("ERROR_FAIL_ACQUIRE_SWAPCHAIN_IMAGE");
+      }
+    }
+
+    // only reset once work is guaranteed to be submitted with the fence
+    if (m_settings.pacing == FramePacing::FENCES) {
+      m_vk.vkResetFences(m_logicalDevice, 1, &m_inFlightFences[m_currentFrame]);
+    }
 
     // record command buffer
-    vkResetCommandBuffer(m_commandBuffer, 0);
-    recordCommandBuffer(m_commandBuffer, imageIndex);
+    m_vk.vkResetCommandBuffer(commandBuffer, 0);
+    recordCommandBuffer(commandBuffer, imageIndex);
 
     // submit the command buffer
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphore};
+    VkSemaphore waitSemaphores[] = {m_imageAvailableSemaphores[m_currentFrame]};
     VkPipelineStageFlags waitStages[] = {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
     };
 
-    submitInfo.waitSemaphoreCount = 1;
+    // headless frames have no image to wait for
+    submitInfo.waitSemaphoreCount = m_settings.headless ? 0 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &m_commandBuffer;
+    submitInfo.pCommandBuffers = &commandBuffer;
+
+    // the binary semaphores ignore their entries in the value arrays
+    VkSemaphore signalSemaphores[2];
+    uint64_t signalValues[2];
+    uint32_t signalCount = 0;
+
+    if (!m_settings.headless) {
+      signalSemaphores[signalCount] = m_renderFinishedSemaphores[imageIndex];
+      signalValues[signalCount++] = 0;
+    }
 
-    VkSemaphore signalSemaphores[] = {m_renderFinishedSemaphore};
-    submitInfo.signalSemaphoreCount = 1;
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      signalSemaphores[signalCount] = m_frameTimeline;
+      signalValues[signalCount++] = frameNumber;
+    }
+
+    submitInfo.signalSemaphoreCount = signalCount;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
-    VkResult result = vkQueueSubmit(
-      m_graphicsQueue, 1, &submitInfo, m_inFlightFence
+    uint64_t waitValues[] = {0};
+
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo{};
+    timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSubmitInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+    timelineSubmitInfo.pWaitSemaphoreValues = waitValues;
+    timelineSubmitInfo.signalSemaphoreValueCount = signalCount;
+    timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+
+    VkFence inFlightFence = VK_NULL_HANDLE;
+
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      submitInfo.pNext = &timelineSubmitInfo;
+    } else {
+      inFlightFence = m_inFlightFences[m_currentFrame];
+    }
+
+    auto submitStartTime = StartupProfiler::Clock::now();
+    result = m_vk.vkQueueSubmit(
+      m_graphicsQueue, 1, &submitInfo, inFlightFence
     );
 
     if (result != VK_SUCCESS) {
       throw std::runtime_error("ERROR_FAIL_SUBMIT_GRAPHICS_QUEUE");
     }
 
+    if (frameNumber == 1) {
+      m_startupProfiler.record(
+        "first_frame_submit", submitStartTime, StartupProfiler::Clock::now()
+      );
+    }
+
+    m_submittedFrame = frameNumber;
+    m_frameSlotNumbers[m_currentFrame] = frameNumber;
+
+    if (m_settings.headless) {
+      m_currentFrame = (m_currentFrame + 1) % m_settings.framesInFlight;
+      profileStartupFrame(frameNumber);
+      return;
+    }
+
     VkSwapchainKHR swapChains[] = {m_vkSwapChain};
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &m_renderFinishedSemaphores[imageIndex];
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr; // Optional
 
-    vkQueuePresentKHR(m_presentationQueue, &presentInfo);
+    // frame numbers only grow, so they double as present ids
+    VkPresentIdKHR presentId{};
+    presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+    presentId.swapchainCount = 1;
+    presentId.pPresentIds = &frameNumber;
+
+    if (m_presentWaitEnabled) {
+      presentInfo.pNext = &presentId;
+    }
+
+    auto presentStartTime = StartupProfiler::Clock::now();
+    result = m_vk.vkQueuePresentKHR(m_presentationQueue, &presentInfo);
+
+    if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+      m_pendingLatencies.push_back({frameNumber, frameStartTime, m_presentMode});
+    }
+
+    if (frameNumber == 1) {
+      m_startupProfiler.record(
+        "first_frame_present", presentStartTime, StartupProfiler::Clock::now()
+      );
+    }
+    profileStartupFrame(frameNumber);
+
+    m_currentFrame = (m_currentFrame + 1) % m_settings.framesInFlight;
+
+    if (
+      result == VK_ERROR_OUT_OF_DATE_KHR ||
+      result == VK_SUBOPTIMAL_KHR ||
+      m_framebufferResized ||
+      m_presentPolicyChanged
+    ) {
+      if (m_presentPolicyChanged) {
+        reportPresentLatency();
+      }
+
+      m_framebufferResized = false;
+      m_presentPolicyChanged = false;
+      recreateSwapChain();
+    } else if (result != VK_SUCCESS) {
+      throw std::runtime_error("ERROR_FAIL_PRESENT_SWAPCHAIN_IMAGE");
+    }
+  }
+
+  // the first frame may go out before the pipeline is compiled, the
+  // report waits for the first one with the triangle in it
+  void profileStartupFrame(uint64_t frameNumber) {
+    if (!m_startupProfiler.isActive()) {
+      return;
+    }
+
+    if (frameNumber == 1) {
+      m_startupProfiler.mark("time_to_first_frame");
+    }
+
+    if (m_frameDrawsTriangle) {
+      m_startupProfiler.mark("time_to_first_triangle");
+      m_startupProfiler.finish(m_settings.startupProfilePath);
+    }
   }
 
   void mainLoop() {
     std::cout << "MAIN_LOOP_START" << '\n';
+
+    if (m_settings.headless) {
+      headlessLoop();
+      return;
+    }
+
+    uint32_t frameCount = 0;
     while (!glfwWindowShouldClose(m_window)) {
+      if (m_settings.frameCount > 0 && frameCount == m_settings.frameCount) {
+        break;
+      }
+
       glfwPollEvents();
       drawFrame();
+      ++frameCount;
+    }
+
+    vkDeviceWaitIdle(m_logicalDevice);
+
+    flushReadbacks();
+    reportPresentLatency();
+  }
+
+  void headlessLoop() {
+    // without a window something else has to end the run
+    uint32_t frameCount = m_settings.frameCount > 0 ? m_settings.frameCount : 60;
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < frameCount; ++i) {
+      drawFrame();
     }
 
     vkDeviceWaitIdle(m_logicalDevice);
+
+    std::chrono::duration<double, std::milli> elapsed = (
+      std::chrono::steady_clock::now() - startTime
+    );
+
+    flushReadbacks();
+
+    m_msPerFrame = elapsed.count() / frameCount;
+
+    std::cout << "HEADLESS_FRAMES: " << frameCount << ", "
+      << elapsed.count() << " ms, "
+      << elapsed.count() / frameCount << " ms/frame" << '\n';
   }
 
   void cleanup() {
-    vkDestroySemaphore(m_logicalDevice, m_imageAvailableSemaphore, nullptr);
-    vkDestroySemaphore(m_logicalDevice, m_renderFinishedSemaphore, nullptr);
-    vkDestroyFence(m_logicalDevice, m_inFlightFence, nullptr);
+    // a run that never drew the triangle still reports its startup
+    m_startupProfiler.finish(m_settings.startupProfilePath);
+
+    // the device is idle at this point
+    for (DeferredDestroy& deferred : m_deletionQueue) {
+      deferred.destroy();
+    }
+    m_deletionQueue.clear();
+
+    for (ReadbackBuffer& readback : m_readbackRing) {
+      destroyReadbackBuffer(readback);
+    }
+
+    for (uint32_t i = 0; i < m_settings.framesInFlight; ++i) {
+      vkDestroySemaphore(m_logicalDevice, m_imageAvailableSemaphores[i], nullptr);
+    }
+
+    for (VkFence fence : m_inFlightFences) {
+      vkDestroyFence(m_logicalDevice, fence, nullptr);
+    }
+
+    if (m_frameTimeline != VK_NULL_HANDLE) {
+      vkDestroySemaphore(m_logicalDevice, m_frameTimeline, nullptr);
+    }
+
+    for (VkSemaphore semaphore : m_renderFinishedSemaphores) {
+      vkDestroySemaphore(m_logicalDevice, semaphore, nullptr);
+    }
 
     vkDestroyCommandPool(m_logicalDevice, m_commandPool, nullptr);
 
-    for (auto framebuffer : m_swapChainFramebuffers) {
-      vkDestroyFramebuffer(m_logicalDevice, framebuffer, nullptr);
+    for (auto framebuffer : m_swapChainFramebuffers) {
+      vkDestroyFramebuffer(m_logicalDevice, framebuffer, nullptr);
+    }
+
+    if (m_renderPass != VK_NULL_HANDLE) {
+      vkDestroyRenderPass(m_logicalDevice, m_renderPass, nullptr);
+    }
+
+    // lets the compiles still in flight finish, their results are owned here
+    m_pipelineCompiler.stop();
+
+    reportPipelineVariantStats();
+    for (const auto& [desc, future] : m_pipelineVariants) {
+      try {
+        vkDestroyPipeline(m_logicalDevice, future.get(), nullptr);
+      } catch (const std::exception&) {
+        // failed compiles have nothing to destroy
+      }
+    }
+    m_pipelineVariants.clear();
+
+    for (const PipelineFuture& future : m_stalePipelines) {
+      try {
+        vkDestroyPipeline(m_logicalDevice, future.get(), nullptr);
+      } catch (const std::exception&) {
+        // failed compiles have nothing to destroy
+      }
+    }
+    m_stalePipelines.clear();
+
+    for (const auto& [desc, shader] : m_shaderObjects) {
+      m_shaderObjectFunctions.destroyShader(m_logicalDevice, shader, nullptr);
+    }
+    m_shaderObjects.clear();
+
+    // the linked pipelines do not need their libraries anymore
+    for (auto& libraries : m_pipelineLibraries) {
+      for (const auto& [desc, library] : libraries) {
+        vkDestroyPipeline(m_logicalDevice, library, nullptr);
+      }
+      libraries.clear();
+    }
+
+    for (const auto& [key, info] : m_pipelineLayouts) {
+      vkDestroyPipelineLayout(m_logicalDevice, info.layout, nullptr);
     }
+    m_pipelineLayouts.clear();
 
-    vkDestroyRenderPass(m_logicalDevice, m_renderPass, nullptr);
+    for (const auto& [key, setLayout] : m_descriptorSetLayouts) {
+      vkDestroyDescriptorSetLayout(m_logicalDevice, setLayout, nullptr);
+    }
+    m_descriptorSetLayouts.clear();
 
-    vkDestroyPipeline(m_logicalDevice, m_graphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(m_logicalDevice, m_pipelineLayout, nullptr);
+    savePipelineCache();
+    vkDestroyPipelineCache(m_logicalDevice, m_pipelineCache, nullptr);
 
     for (VkImageView imageView : m_swapChainImageViews) {
       vkDestroyImageView(m_logicalDevice, imageView, nullptr);
     }
 
-    vkDestroySwapchainKHR(m_logicalDevice, m_vkSwapChain, nullptr);
+    if (m_settings.headless) {
+      for (size_t i = 0; i < m_swapChainImages.size(); ++i) {
+        vkDestroyImage(m_logicalDevice, m_swapChainImages[i], nullptr);
+        vkFreeMemory(m_logicalDevice, m_offscreenImageMemory[i], nullptr);
+      }
+    } else {
+      vkDestroySwapchainKHR(m_logicalDevice, m_vkSwapChain, nullptr);
+    }
 
     vkDestroyDevice(m_logicalDevice, nullptr);
 
@@ -869,20 +5456,28 @@ private:
         DestroyDebugUtilsMessengerEXT(m_vkInstance, m_debugMessenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
+    if (!m_settings.headless) {
+      vkDestroySurfaceKHR(m_vkInstance, m_vkSurface, nullptr);
+    }
 
     vkDestroyInstance(m_vkInstance, nullptr);
 
-    glfwDestroyWindow(m_window);
-    glfwTerminate();
+    if (!m_settings.headless) {
+      glfwDestroyWindow(m_window);
+      glfwTerminate();
+    }
   }
 
   std::vector<const char*> getRequiredExtensions() {
-      uint32_t glfwExtensionCount = 0;
-      const char** glfwExtensions;
-      glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+      std::vector<const char*> extensions;
 
-      std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+      if (!m_settings.headless) {
+        uint32_t glfwExtensionCount = 0;
+        const char** glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+      }
 
       if (enableValidationLayers) {
           extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -924,33 +5519,125 @@ private:
     return true;
   }
 
-  QueueFamilyIndices findQueueFamilies(VkPhysicalDevice physicalDevice) {
-    QueueFamilyIndices indices;
+  // the single place the physical device is queried, everything else
+  // reads the snapshot
+  DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice physicalDevice) {
+    DeviceCapabilities capabilities;
+    capabilities.physicalDevice = physicalDevice;
+
+    vkGetPhysicalDeviceProperties(physicalDevice, &capabilities.properties);
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &capabilities.memoryProperties);
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(
+      physicalDevice, nullptr, &extensionCount, nullptr
+    );
+
+    std::vector<VkExtensionProperties> extPropertiesVector(extensionCount);
+    vkEnumerateDeviceExtensionProperties(
+      physicalDevice, nullptr, &extensionCount, extPropertiesVector.data()
+    );
+
+    for (const auto& extension : extPropertiesVector) {
+      capabilities.extensions.insert(extension.extensionName);
+    }
+
+    // one features query, chained with whatever the device can report
+    uint32_t apiVersion = capabilities.properties.apiVersion;
+    void* featureChain = nullptr;
+
+    capabilities.vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (apiVersion >= VK_API_VERSION_1_2) {
+      capabilities.vulkan12Features.pNext = featureChain;
+      featureChain = &capabilities.vulkan12Features;
+    }
+
+    capabilities.vulkan13Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+    if (apiVersion >= VK_API_VERSION_1_3) {
+      capabilities.vulkan13Features.pNext = featureChain;
+      featureChain = &capabilities.vulkan13Features;
+    }
+
+    capabilities.shaderObjectFeatures.sType = (
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_OBJECT_FEATURES_EXT
+    );
+    if (capabilities.hasExtension(VK_EXT_SHADER_OBJECT_EXTENSION_NAME)) {
+      capabilities.shaderObjectFeatures.pNext = featureChain;
+      featureChain = &capabilities.shaderObjectFeatures;
+    }
+
+    capabilities.pipelineLibraryFeatures.sType = (
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT
+    );
+    if (capabilities.hasExtensions(pipelineLibraryDeviceExtensions)) {
+      capabilities.pipelineLibraryFeatures.pNext = featureChain;
+      featureChain = &capabilities.pipelineLibraryFeatures;
+    }
+
+    capabilities.presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+    capabilities.presentWaitFeatures.sType = (
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR
+    );
+    if (capabilities.hasExtensions(presentWaitDeviceExtensions)) {
+      capabilities.presentIdFeatures.pNext = featureChain;
+      capabilities.presentWaitFeatures.pNext = &capabilities.presentIdFeatures;
+      featureChain = &capabilities.presentWaitFeatures;
+    }
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = featureChain;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+    capabilities.features = features2.features;
+
+    // the chain points into this copy, which is about to move
+    capabilities.vulkan12Features.pNext = nullptr;
+    capabilities.vulkan13Features.pNext = nullptr;
+    capabilities.shaderObjectFeatures.pNext = nullptr;
+    capabilities.pipelineLibraryFeatures.pNext = nullptr;
+    capabilities.presentIdFeatures.pNext = nullptr;
+    capabilities.presentWaitFeatures.pNext = nullptr;
 
     uint32_t queueFamilyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(
       physicalDevice, &queueFamilyCount, nullptr
     );
 
-    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    capabilities.queueFamilies.resize(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(
-      physicalDevice, &queueFamilyCount, queueFamilies.data()
+      physicalDevice, &queueFamilyCount, capabilities.queueFamilies.data()
     );
 
+    capabilities.queueFamilyIndices = findQueueFamilies(capabilities);
+
+    if (!m_settings.headless) {
+      capabilities.swapChainSupport = querySwapChainSupport(physicalDevice);
+    }
+
+    return capabilities;
+  }
+
+  QueueFamilyIndices findQueueFamilies(const DeviceCapabilities& capabilities) {
+    QueueFamilyIndices indices;
+
     VkBool32 presentationSupport = false;
 
     int i = 0;
-    for (const auto& family : queueFamilies) {
+    for (const auto& family : capabilities.queueFamilies) {
 
       if (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
 
         // queue families query
         indices.graphicsFamily = i;
 
-        // presentation support query
-        vkGetPhysicalDeviceSurfaceSupportKHR(
-          physicalDevice, i, m_vkSurface, &presentationSupport
-        );
+        // presentation support query, headless never presents
+        if (m_settings.headless) {
+          presentationSupport = VK_TRUE;
+        } else {
+          vkGetPhysicalDeviceSurfaceSupportKHR(
+            capabilities.physicalDevice, i, m_vkSurface, &presentationSupport
+          );
+        }
 
         if (presentationSupport) {
           indices.presentationFamily = i;
@@ -993,58 +5680,127 @@ private:
     return details;
   }
 
-  bool isDeviceSuitable(VkPhysicalDevice device) {
-    // acquire device properties
-    VkPhysicalDeviceProperties deviceProperties{};
-    vkGetPhysicalDeviceProperties(device, &deviceProperties);
+  // the extent limits follow the window, formats and present modes do not
+  void refreshSurfaceCapabilities() {
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(
+      m_physicalDevice, m_vkSurface, &m_capabilities.swapChainSupport.capabilities
+    );
+  }
+
+  bool isDeviceSuitable(const DeviceCapabilities& capabilities) {
+    // check extensions
+    bool extensionsSupported = capabilities.hasExtensions(getRequiredDeviceExtensions());
+    bool swapChainAdequate = m_settings.headless;
+
+    if (extensionsSupported && !m_settings.headless) {
+        const SwapChainSupportDetails& swapChainSupport = capabilities.swapChainSupport;
+        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+    }
 
-    // acquire device features
-    VkPhysicalDeviceFeatures deviceFeatures{};
-    vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+    bool pacingSupported = true;
+    if (m_settings.pacing == FramePacing::TIMELINE) {
+      pacingSupported = checkTimelineSemaphoreSupport(capabilities);
+    }
 
-    std::cout << "VK_PD_TYPE: " << deviceProperties.deviceType << '\n';
-    std::cout << "VK_PD_GEO_SHADER: " << deviceFeatures.geometryShader << '\n';
+    return (
+      capabilities.queueFamilyIndices.isComplete() &&
+      extensionsSupported && swapChainAdequate && pacingSupported
+    );
+  }
 
-    // queue family indices
-    QueueFamilyIndices indices = findQueueFamilies(device);
+  // the device type decides, everything else only orders devices of the
+  // same type, so a software rasterizer never beats real hardware
+  uint64_t scoreDevice(const DeviceCapabilities& capabilities) {
+    uint64_t typeRank = 0;
+    switch (capabilities.properties.deviceType) {
+      case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeRank = 4; break;
+      case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeRank = 3; break;
+      case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeRank = 2; break;
+      case VK_PHYSICAL_DEVICE_TYPE_CPU: typeRank = 1; break;
+      default: break;
+    }
 
-    // check extensions
-    bool extensionsSupported = checkDeviceExtensionSupport(device);
-    bool swapChainAdequate = false;
+    // one point per 64 MiB, integrated GPUs report shared system memory
+    uint64_t score = std::min<uint64_t>(deviceLocalMemorySize(capabilities) >> 26, 4096);
 
-    if (extensionsSupported) {
-        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-        swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+    // async compute and copies off the graphics queue
+    bool dedicatedCompute = false;
+    bool dedicatedTransfer = false;
+    for (const auto& family : capabilities.queueFamilies) {
+      VkQueueFlags flags = family.queueFlags;
+      if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+        dedicatedCompute = true;
+      }
+      if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+        dedicatedTransfer = true;
+      }
     }
+    score += dedicatedCompute ? 1000 : 0;
+    score += dedicatedTransfer ? 1000 : 0;
+
+    // the faster paths this app can take
+    score += checkTimelineSemaphoreSupport(capabilities) ? 250 : 0;
+    score += checkDynamicRenderingSupport(capabilities) ? 250 : 0;
+    score += checkShaderObjectSupport(capabilities) ? 250 : 0;
+    score += checkPipelineLibrarySupport(capabilities) ? 250 : 0;
+
+    score += capabilities.properties.limits.maxImageDimension2D / 256;
 
-    return indices.isComplete() && extensionsSupported && swapChainAdequate;
-    // OBSERVATION: We could do more advanced stuff, but not for now
-    // return (
-    //   deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU
-    // );
+    return typeRank * 100000 + score;
   }
 
-  bool checkDeviceExtensionSupport(VkPhysicalDevice phyiscalDevice) {
-    uint32_t extensionCount;
-    vkEnumerateDeviceExtensionProperties(
-      phyiscalDevice, nullptr, &extensionCount, nullptr
-    );
+  // the largest heap, not the sum, several heaps may alias the same memory
+  static VkDeviceSize deviceLocalMemorySize(const DeviceCapabilities& capabilities) {
+    const VkPhysicalDeviceMemoryProperties& memory = capabilities.memoryProperties;
 
-    std::vector<VkExtensionProperties> extPropertiesVector(extensionCount);
-    vkEnumerateDeviceExtensionProperties(
-      phyiscalDevice, nullptr, &extensionCount, extPropertiesVector.data()
-    );
+    VkDeviceSize size = 0;
+    for (uint32_t i = 0; i < memory.memoryHeapCount; ++i) {
+      if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+        size = std::max(size, memory.memoryHeaps[i].size);
+      }
+    }
 
-    std::set<std::string> requiredExtensions(
-      deviceExtensions.begin(),
-      deviceExtensions.end()
-    );
+    return size;
+  }
 
-    for (const auto& extension : extPropertiesVector) {
-      requiredExtensions.erase(extension.extensionName);
+  static const char* deviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+      case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+      case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+      case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+      case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+      default: return "other";
     }
+  }
 
-    return requiredExtensions.empty();
+  static std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {
+      return static_cast<char>(std::tolower(c));
+    });
+    return text;
+  }
+
+  bool checkTimelineSemaphoreSupport(const DeviceCapabilities& capabilities) {
+    return capabilities.vulkan12Features.timelineSemaphore == VK_TRUE;
+  }
+
+  bool checkDynamicRenderingSupport(const DeviceCapabilities& capabilities) {
+    return capabilities.vulkan13Features.dynamicRendering == VK_TRUE;
+  }
+
+  bool checkShaderObjectSupport(const DeviceCapabilities& capabilities) {
+    return capabilities.shaderObjectFeatures.shaderObject == VK_TRUE;
+  }
+
+  bool checkPipelineLibrarySupport(const DeviceCapabilities& capabilities) {
+    return capabilities.pipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+  }
+
+  bool checkPresentWaitSupport(const DeviceCapabilities& capabilities) {
+    return (
+      capabilities.presentIdFeatures.presentId == VK_TRUE &&
+      capabilities.presentWaitFeatures.presentWait == VK_TRUE
+    );
   }
 
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(
@@ -1062,15 +5818,65 @@ private:
   VkPresentModeKHR chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR>& availablePresentModes
   ) {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
+    std::vector<VkPresentModeKHR> preferredModes;
+
+    switch (m_settings.presentPolicy) {
+      case PresentPolicy::LOW_LATENCY:
+        preferredModes = {
+          VK_PRESENT_MODE_MAILBOX_KHR,
+          VK_PRESENT_MODE_IMMEDIATE_KHR
+        };
+        break;
+      case PresentPolicy::ADAPTIVE:
+        preferredModes = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+        break;
+      case PresentPolicy::POWER_SAVING:
+        break;
+    }
+
+    for (const auto& preferredMode : preferredModes) {
+      for (const auto& availablePresentMode : availablePresentModes) {
+        if (availablePresentMode == preferredMode) {
+          return availablePresentMode;
         }
+      }
     }
 
+    // FIFO is the only mode every surface supports
     return VK_PRESENT_MODE_FIFO_KHR;
   }
 
+  uint32_t chooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities) {
+    uint32_t imageCount = m_settings.swapChainImageCount;
+    if (imageCount == 0) {
+      imageCount = capabilities.minImageCount + 1;
+    }
+
+    imageCount = std::max(imageCount, capabilities.minImageCount);
+
+    // a maximum of 0 means there is no limit
+    if (capabilities.maxImageCount > 0) {
+      imageCount = std::min(imageCount, capabilities.maxImageCount);
+    }
+
+    return imageCount;
+  }
+
+  static const char* presentModeName(VkPresentModeKHR presentMode) {
+    switch (presentMode) {
+      case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "IMMEDIATE";
+      case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "MAILBOX";
+      case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+      case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO_RELAXED";
+      default:
+        return "UNKNOWN";
+    }
+  }
+
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
     if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
         return capabilities.currentExtent;
@@ -1090,11 +5896,11 @@ private:
     }
   }
 
-  VkShaderModule createShaderModule(const std::vector<char>& code) {
+  VkShaderModule createShaderModule(const SpirvBlob& code) {
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.pCode = code.words();
 
     VkShaderModule shaderModule;
     VkResult result = vkCreateShaderModule(
@@ -1108,6 +5914,111 @@ private:
     return shaderModule;
   }
 
+  // clears the color target and starts drawing into it, through the
+  // render pass or through dynamic rendering
+  void beginColorPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+
+    if (!m_dynamicRenderingEnabled) {
+      // render pass
+      VkRenderPassBeginInfo renderPassInfo{};
+      renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+      renderPassInfo.renderPass = m_renderPass;
+      renderPassInfo.framebuffer = m_swapChainFramebuffers[imageIndex];
+      renderPassInfo.renderArea.offset = {0, 0};
+      renderPassInfo.renderArea.extent = m_swapChainExtent;
+
+      renderPassInfo.clearValueCount = 1;
+      renderPassInfo.pClearValues = &clearColor;
+
+      m_vk.vkCmdBeginRenderPass(
+        commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE
+      );
+      return;
+    }
+
+    // what the render pass did implicitly: the previous contents are
+    // cleared anyway, so the transition starts from UNDEFINED; it waits
+    // for the same stage the image acquire semaphore does
+    VkImageMemoryBarrier toAttachment{};
+    toAttachment.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toAttachment.srcAccessMask = 0;
+    toAttachment.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toAttachment.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    toAttachment.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toAttachment.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toAttachment.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toAttachment.image = m_swapChainImages[imageIndex];
+    toAttachment.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toAttachment.subresourceRange.levelCount = 1;
+    toAttachment.subresourceRange.layerCount = 1;
+
+    m_vk.vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &toAttachment
+    );
+
+    VkRenderingAttachmentInfo colorAttachment{};
+    colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    colorAttachment.imageView = m_swapChainImageViews[imageIndex];
+    colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.clearValue = clearColor;
+
+    VkRenderingInfo renderingInfo{};
+    renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    renderingInfo.renderArea.offset = {0, 0};
+    renderingInfo.renderArea.extent = m_swapChainExtent;
+    renderingInfo.layerCount = 1;
+    renderingInfo.colorAttachmentCount = 1;
+    renderingInfo.pColorAttachments = &colorAttachment;
+
+    m_vk.vkCmdBeginRendering(commandBuffer, &renderingInfo);
+  }
+
+  void endColorPass(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+    if (!m_dynamicRenderingEnabled) {
+      m_vk.vkCmdEndRenderPass(commandBuffer);
+      return;
+    }
+
+    m_vk.vkCmdEndRendering(commandBuffer);
+
+    // the render pass' final layout and outgoing dependency, so captures
+    // and presentation see the same image either way
+    VkImageMemoryBarrier toFinalLayout{};
+    toFinalLayout.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    toFinalLayout.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toFinalLayout.dstAccessMask = (
+      isCaptureEnabled() ? VK_ACCESS_TRANSFER_READ_BIT : 0
+    );
+    toFinalLayout.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toFinalLayout.newLayout = m_colorTargetFinalLayout;
+    toFinalLayout.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toFinalLayout.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    toFinalLayout.image = m_swapChainImages[imageIndex];
+    toFinalLayout.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    toFinalLayout.subresourceRange.levelCount = 1;
+    toFinalLayout.subresourceRange.layerCount = 1;
+
+    m_vk.vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      isCaptureEnabled() ?
+        VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0,
+      0, nullptr,
+      0, nullptr,
+      1, &toFinalLayout
+    );
+  }
+
   void recordCommandBuffer(
     VkCommandBuffer commandBuffer,
     uint32_t imageIndex
@@ -1120,41 +6031,174 @@ private:
     beginInfo.flags = 0;
     beginInfo.pInheritanceInfo = nullptr;
 
-    result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    result = m_vk.vkBeginCommandBuffer(commandBuffer, &beginInfo);
     if (result != VK_SUCCESS) {
       throw std::runtime_error("ERROR_FAIL_COMMAND_BUFFER_BEGIN");
     }
 
-    // render pass
-    VkRenderPassBeginInfo renderPassInfo{};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = m_renderPass;
-    renderPassInfo.framebuffer = m_swapChainFramebuffers[imageIndex];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = m_swapChainExtent;
+    beginColorPass(commandBuffer, imageIndex);
 
-    VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
+    // drawing commands
+    if (m_shaderObjectsEnabled) {
+      recordShaderObjectDraw(commandBuffer);
+    } else {
+      recordPipelineDraw(commandBuffer);
+    }
 
-    vkCmdBeginRenderPass(
-      commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE
-    );
+    endColorPass(commandBuffer, imageIndex);
 
-    // drawing commands
-    vkCmdBindPipeline(
-      commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphicsPipeline
-    );
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    if (isCaptureEnabled()) {
+      recordReadbackCopy(commandBuffer, imageIndex);
+    }
 
     // end command buffer recording
-    result = vkEndCommandBuffer(commandBuffer);
+    result = m_vk.vkEndCommandBuffer(commandBuffer);
     if (result != VK_SUCCESS) {
       throw std::runtime_error("ERROR_FAIL_COMMAND_BUFFER_RECORDING");
     }
 
   }
 
+  void recordPipelineDraw(VkCommandBuffer commandBuffer) {
+    VkPipeline pipeline = currentTrianglePipeline();
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float) m_swapChainExtent.width;
+    viewport.height = (float) m_swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    m_vk.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = m_swapChainExtent;
+    m_vk.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    m_vk.vkCmdSetLineWidth(commandBuffer, 1.0f);
+
+    if (m_extendedDynamicStateEnabled) {
+      const GraphicsPipelineDesc& desc = m_trianglePipelineDesc;
+      m_vk.vkCmdSetCullMode(commandBuffer, desc.cullMode);
+      m_vk.vkCmdSetFrontFace(commandBuffer, desc.frontFace);
+      m_vk.vkCmdSetPrimitiveTopology(commandBuffer, desc.topology);
+
+      // there is no depth attachment yet
+      m_vk.vkCmdSetDepthTestEnable(commandBuffer, VK_FALSE);
+      m_vk.vkCmdSetDepthWriteEnable(commandBuffer, VK_FALSE);
+      m_vk.vkCmdSetDepthCompareOp(commandBuffer, VK_COMPARE_OP_LESS);
+    }
+
+    // skipped while the pipeline compiles and there is nothing to fall back to
+    m_frameDrawsTriangle = pipeline != VK_NULL_HANDLE;
+    if (pipeline != VK_NULL_HANDLE) {
+      m_vk.vkCmdBindPipeline(
+        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline
+      );
+      m_vk.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    }
+  }
+
+  // with shader objects every piece of state a pipeline would hold is set
+  // here, taken from the triangle's description
+  void recordShaderObjectDraw(VkCommandBuffer commandBuffer) {
+    m_frameDrawsTriangle = true;
+    const GraphicsPipelineDesc& desc = m_trianglePipelineDesc;
+    const ShaderObjectFunctions& functions = m_shaderObjectFunctions;
+
+    VkShaderStageFlagBits stages[] = {
+      VK_SHADER_STAGE_VERTEX_BIT,
+      VK_SHADER_STAGE_FRAGMENT_BIT
+    };
+    VkShaderEXT shaders[] = {m_vertShaderObject, m_fragShaderObject};
+    functions.cmdBindShaders(commandBuffer, 2, stages, shaders);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = (float) m_swapChainExtent.width;
+    viewport.height = (float) m_swapChainExtent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    m_vk.vkCmdSetViewportWithCount(commandBuffer, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = m_swapChainExtent;
+    m_vk.vkCmdSetScissorWithCount(commandBuffer, 1, &scissor);
+
+    // vertex input as reflected from the vertex shader
+    std::vector<VkVertexInputBindingDescription2EXT> vertexBindings;
+    for (const VkVertexInputBindingDescription& binding : desc.vertexBindings) {
+      VkVertexInputBindingDescription2EXT binding2{};
+      binding2.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_BINDING_DESCRIPTION_2_EXT;
+      binding2.binding = binding.binding;
+      binding2.stride = binding.stride;
+      binding2.inputRate = binding.inputRate;
+      binding2.divisor = 1;
+      vertexBindings.push_back(binding2);
+    }
+
+    std::vector<VkVertexInputAttributeDescription2EXT> vertexAttributes;
+    for (const VkVertexInputAttributeDescription& attribute : desc.vertexAttributes) {
+      VkVertexInputAttributeDescription2EXT attribute2{};
+      attribute2.sType = VK_STRUCTURE_TYPE_VERTEX_INPUT_ATTRIBUTE_DESCRIPTION_2_EXT;
+      attribute2.location = attribute.location;
+      attribute2.binding = attribute.binding;
+      attribute2.format = attribute.format;
+      attribute2.offset = attribute.offset;
+      vertexAttributes.push_back(attribute2);
+    }
+
+    functions.cmdSetVertexInput(
+      commandBuffer,
+      static_cast<uint32_t>(vertexBindings.size()), vertexBindings.data(),
+      static_cast<uint32_t>(vertexAttributes.size()), vertexAttributes.data()
+    );
+    m_vk.vkCmdSetPrimitiveTopology(commandBuffer, desc.topology);
+    m_vk.vkCmdSetPrimitiveRestartEnable(commandBuffer, VK_FALSE);
+
+    // rasterizer
+    m_vk.vkCmdSetRasterizerDiscardEnable(commandBuffer, VK_FALSE);
+    functions.cmdSetPolygonMode(commandBuffer, desc.polygonMode);
+    m_vk.vkCmdSetCullMode(commandBuffer, desc.cullMode);
+    m_vk.vkCmdSetFrontFace(commandBuffer, desc.frontFace);
+    m_vk.vkCmdSetDepthBiasEnable(commandBuffer, VK_FALSE);
+    m_vk.vkCmdSetLineWidth(commandBuffer, 1.0f);
+
+    // multisampling
+    VkSampleMask sampleMask = ~0u;
+    functions.cmdSetRasterizationSamples(commandBuffer, desc.samples);
+    functions.cmdSetSampleMask(commandBuffer, desc.samples, &sampleMask);
+    functions.cmdSetAlphaToCoverageEnable(commandBuffer, VK_FALSE);
+
+    // there is no depth attachment yet
+    m_vk.vkCmdSetDepthTestEnable(commandBuffer, VK_FALSE);
+    m_vk.vkCmdSetDepthWriteEnable(commandBuffer, VK_FALSE);
+    m_vk.vkCmdSetDepthCompareOp(commandBuffer, VK_COMPARE_OP_LESS);
+    m_vk.vkCmdSetDepthBoundsTestEnable(commandBuffer, VK_FALSE);
+    m_vk.vkCmdSetStencilTestEnable(commandBuffer, VK_FALSE);
+
+    // color blending
+    VkBool32 blendEnable = desc.blendEnable ? VK_TRUE : VK_FALSE;
+    functions.cmdSetColorBlendEnable(commandBuffer, 0, 1, &blendEnable);
+    functions.cmdSetColorWriteMask(commandBuffer, 0, 1, &desc.colorWriteMask);
+
+    if (desc.blendEnable) {
+      VkColorBlendEquationEXT blendEquation{};
+      blendEquation.srcColorBlendFactor = desc.srcColorBlendFactor;
+      blendEquation.dstColorBlendFactor = desc.dstColorBlendFactor;
+      blendEquation.colorBlendOp = desc.colorBlendOp;
+      blendEquation.srcAlphaBlendFactor = desc.srcAlphaBlendFactor;
+      blendEquation.dstAlphaBlendFactor = desc.dstAlphaBlendFactor;
+      blendEquation.alphaBlendOp = desc.alphaBlendOp;
+      functions.cmdSetColorBlendEquation(commandBuffer, 0, 1, &blendEquation);
+    }
+
+    m_vk.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+  }
+
   static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
     VkDebugUtilsMessageTypeFlagsEXT messageType,
@@ -1169,12 +6213,264 @@ private:
 };
 
 
+// accepts options in the form --name=value
+AppSettings parseArgs(int argc, char const *argv[]) {
+  AppSettings settings;
+
+  // --device wins over the environment
+  if (const char* device = std::getenv("HELLO_TRIANGLE_DEVICE")) {
+    settings.physicalDevice = device;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::string value;
+
+    size_t separator = arg.find('=');
+    if (separator != std::string::npos) {
+      value = arg.substr(separator + 1);
+      arg = arg.substr(0, separator);
+    }
+
+    if (arg == "--frames-in-flight") {
+      settings.framesInFlight = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--present-policy") {
+      if (value == "low-latency") {
+        settings.presentPolicy = PresentPolicy::LOW_LATENCY;
+      } else if (value == "power-saving") {
+        settings.presentPolicy = PresentPolicy::POWER_SAVING;
+      } else if (value == "adaptive") {
+        settings.presentPolicy = PresentPolicy::ADAPTIVE;
+      } else {
+        throw std::runtime_error("ERROR_UNKNOWN_PRESENT_POLICY - " + value);
+      }
+    } else if (arg == "--swapchain-images") {
+      settings.swapChainImageCount = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--device") {
+      settings.physicalDevice = value;
+    } else if (arg == "--headless") {
+      settings.headless = true;
+    } else if (arg == "--frames") {
+      settings.frameCount = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--capture") {
+      settings.captureDir = value;
+    } else if (arg == "--capture-format") {
+      if (value == "ppm") {
+        settings.captureFormat = CaptureFormat::PPM;
+      } else if (value == "raw") {
+        settings.captureFormat = CaptureFormat::RAW;
+      } else {
+        throw std::runtime_error("ERROR_UNKNOWN_CAPTURE_FORMAT - " + value);
+      }
+    } else if (arg == "--rendering") {
+      if (value == "render-pass") {
+        settings.renderingBackend = RenderingBackend::RENDER_PASS;
+      } else if (value == "dynamic") {
+        settings.renderingBackend = RenderingBackend::DYNAMIC_RENDERING;
+      } else {
+        throw std::runtime_error("ERROR_UNKNOWN_RENDERING_BACKEND - " + value);
+      }
+    } else if (arg == "--runtime-shaders") {
+      settings.runtimeShaders = true;
+    } else if (arg == "--shader-cache") {
+      settings.shaderCacheDir = value;
+    } else if (arg == "--shader-define") {
+      size_t equals = value.find('=');
+      if (equals == std::string::npos) {
+        settings.shaderDefines.emplace_back(value, "");
+      } else {
+        settings.shaderDefines.emplace_back(value.substr(0, equals), value.substr(equals + 1));
+      }
+    } else if (arg == "--hot-reload") {
+      settings.hotReload = true;
+    } else if (arg == "--shader-objects") {
+      settings.shaderObjects = true;
+    } else if (arg == "--extended-dynamic-state") {
+      settings.extendedDynamicState = true;
+    } else if (arg == "--pipeline-libraries") {
+      settings.pipelineLibraries = true;
+    } else if (arg == "--init-threads") {
+      settings.initThreads = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--compile-threads") {
+      settings.compileThreads = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--startup-profile") {
+      settings.startupProfilePath = value;
+    } else if (arg == "--pipeline-cache") {
+      settings.pipelineCachePath = value;
+    } else if (arg == "--triangle-color") {
+      std::stringstream color(value);
+      std::string component;
+      for (float& channel : settings.triangleColor) {
+        if (!std::getline(color, component, ',')) {
+          throw std::runtime_error("ERROR_INVALID_TRIANGLE_COLOR - " + value);
+        }
+        channel = std::stof(component);
+      }
+    } else if (arg == "--triangle-scale") {
+      settings.triangleScale = std::stof(value);
+    } else if (arg == "--golden") {
+      settings.goldenDir = value;
+    } else if (arg == "--golden-scene") {
+      settings.goldenScene = value;
+    } else if (arg == "--golden-update") {
+      settings.goldenUpdate = true;
+    } else if (arg == "--golden-tolerance") {
+      settings.goldenTolerance = static_cast<uint32_t>(std::stoul(value));
+    } else if (arg == "--golden-max-slowdown") {
+      settings.goldenMaxSlowdown = std::stod(value);
+    } else if (arg == "--pacing") {
+      if (value == "fences") {
+        settings.pacing = FramePacing::FENCES;
+      } else if (value == "timeline") {
+        settings.pacing = FramePacing::TIMELINE;
+      } else {
+        throw std::runtime_error("ERROR_UNKNOWN_PACING - " + value);
+      }
+    } else {
+      throw std::runtime_error("ERROR_UNKNOWN_ARGUMENT - " + arg);
+    }
+  }
+
+  return settings;
+}
+
+struct GoldenScene {
+  const char* name;
+  uint32_t width;
+  uint32_t height;
+  uint32_t frameCount;
+  uint32_t framesInFlight;
+};
+
+const GoldenScene goldenScenes[] = {
+  {"triangle", 800, 600, 60, 2},
+  {"triangle_small", 64, 48, 30, 2},
+  {"triangle_wide_single_slot", 1024, 256, 30, 1}
+};
+
+// renders each scene headless and compares its last frame with
+// <goldenDir>/<scene>.ppm and its frame time with the baseline recorded
+// on the same device, <goldenDir>/<scene>.<deviceId>.ms
+bool runGoldenScenes(const AppSettings& baseSettings) {
+  bool allPassed = true;
+  bool sceneFound = false;
+
+  for (const GoldenScene& scene : goldenScenes) {
+    if (!baseSettings.goldenScene.empty() && baseSettings.goldenScene != scene.name) {
+      continue;
+    }
+    sceneFound = true;
+
+    AppSettings settings = baseSettings;
+    settings.headless = true;
+    settings.keepLastFrame = true;
+    // the reference frames must contain the triangle
+    settings.compileThreads = 0;
+    settings.frameCount = scene.frameCount;
+    settings.framesInFlight = scene.framesInFlight;
+
+    HelloTriangleApp app(scene.width, scene.height, settings);
+    app.run();
+
+    const RgbImage& image = app.lastFrame();
+    std::string referencePath = baseSettings.goldenDir + "/" + scene.name;
+    std::optional<RgbImage> reference = readPpm(referencePath + ".ppm");
+
+    // frame times only compare on the same device and driver
+    std::string timingPath = referencePath + "." + app.deviceId() + ".ms";
+
+    if (baseSettings.goldenUpdate) {
+      writePpm(referencePath + ".ppm", image);
+      std::ofstream(timingPath, std::ios::trunc) << app.msPerFrame() << '\n';
+
+      std::cout << "GOLDEN_" << scene.name << ": WRITTEN, "
+        << app.msPerFrame() << " ms/frame on " << app.deviceId() << '\n';
+      continue;
+    }
+
+    double referenceMsPerFrame = 0.0;
+    std::ifstream(timingPath) >> referenceMsPerFrame;
+
+    // a missing reference is a failure, otherwise a fresh checkout would
+    // pass without comparing anything
+    if (!reference.has_value()) {
+      std::cout << "GOLDEN_" << scene.name << ": FAIL, no reference in "
+        << baseSettings.goldenDir << ", run with --golden-update to write it" << '\n';
+      allPassed = false;
+      continue;
+    }
+
+    if (reference->width != image.width || reference->height != image.height) {
+      std::cout << "GOLDEN_" << scene.name << ": FAIL, size "
+        << image.width << "x" << image.height << " != reference "
+        << reference->width << "x" << reference->height << '\n';
+      allPassed = false;
+      continue;
+    }
+
+    uint64_t mismatchedPixels = 0;
+    uint32_t maxDifference = 0;
+
+    for (size_t i = 0; i < image.pixels.size(); i += 3) {
+      uint32_t pixelDifference = 0;
+      for (size_t c = 0; c < 3; ++c) {
+        pixelDifference = std::max(
+          pixelDifference,
+          static_cast<uint32_t>(std::abs(image.pixels[i + c] - reference->pixels[i + c]))
+        );
+      }
+
+      maxDifference = std::max(maxDifference, pixelDifference);
+      if (pixelDifference > baseSettings.goldenTolerance) {
+        mismatchedPixels++;
+      }
+    }
+
+    // without a baseline for this device the frame time is only reported
+    bool imagePassed = mismatchedPixels == 0;
+    bool timePassed = (
+      referenceMsPerFrame <= 0.0 ||
+      app.msPerFrame() <= referenceMsPerFrame * baseSettings.goldenMaxSlowdown
+    );
+
+    if (!imagePassed) {
+      writePpm(referencePath + ".actual.ppm", image);
+    }
+
+    std::cout << "GOLDEN_" << scene.name << ": "
+      << (imagePassed && timePassed ? "PASS" : "FAIL") << ", "
+      << mismatchedPixels << " mismatched pixels, "
+      << "max diff " << maxDifference << ", "
+      << app.msPerFrame() << " ms/frame ";
+    if (referenceMsPerFrame > 0.0) {
+      std::cout << "(reference " << referenceMsPerFrame << " ms/frame)" << '\n';
+    } else {
+      std::cout << "(no baseline for " << app.deviceId() << ")" << '\n';
+    }
+
+    allPassed = allPassed && imagePassed && timePassed;
+  }
+
+  if (!sceneFound) {
+    throw std::runtime_error("ERROR_UNKNOWN_GOLDEN_SCENE - " + baseSettings.goldenScene);
+  }
+
+  return allPassed;
+}
+
+// tests/checks.cpp includes this file for its own main()
+#ifndef HELLO_TRIANGLE_NO_MAIN
 int main(int argc, char const *argv[]) {
   std::cout << "START HELLO TRIANGLE APP" << '\n';
 
-  HelloTriangleApp app(800, 600);
-
   try {
+    AppSettings settings = parseArgs(argc, argv);
+
+    if (!settings.goldenDir.empty()) {
+      return runGoldenScenes(settings) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    HelloTriangleApp app(800, 600, settings);
     app.run();
   } catch (const std::exception& e) {
     std::cerr << e.what() << std::endl;
@@ -1184,3 +6480,4 @@ int main(int argc, char const *argv[]) {
   std::cout << "STOP HELLO TRIANGLE APP" << '\n';
   return EXIT_SUCCESS;
 }
+#endif
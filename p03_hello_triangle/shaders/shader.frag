@@ -1,7 +1,12 @@
 # version 450
 
+// specialization constants, set per pipeline variant
+layout(constant_id = 0) const float COLOR_R = 1.0;
+layout(constant_id = 1) const float COLOR_G = 0.0;
+layout(constant_id = 2) const float COLOR_B = 0.0;
+
 layout(location = 0) out vec4 outColor;
 
 void main() {
-  outColor = vec4(1.0, 0.0, 0.0, 0.0);
+  outColor = vec4(COLOR_R, COLOR_G, COLOR_B, 0.0);
 }
@@ -1,5 +1,8 @@
 # version 450
 
+// specialization constant, set per pipeline variant
+layout(constant_id = 3) const float TRIANGLE_SCALE = 1.0;
+
 vec2 positions[3] = vec2[](
   vec2(0.0, -0.5),
   vec2(0.5, 0.5),
@@ -7,5 +10,5 @@ vec2 positions[3] = vec2[](
 );
 
 void main() {
-  gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+  gl_Position = vec4(positions[gl_VertexIndex] * TRIANGLE_SCALE, 0.0, 1.0);
 }
@@ -0,0 +1,155 @@
+// standalone checks of the parts of main.cpp that need no device:
+// shader reflection, pipeline description hashing and init ordering.
+// "make check" builds and runs them from p03_hello_triangle/
+#define HELLO_TRIANGLE_NO_MAIN
+#include "../main.cpp"
+
+static int failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      std::cout << "CHECK_FAILED: " << __FILE__ << ":" << __LINE__ << ": " \
+        << #condition << '\n'; \
+      failures++; \
+    } \
+  } while (false)
+
+// runs the graph and returns the error it threw, empty if it ran through
+static std::string runGraph(InitGraph& graph, uint32_t threadCount) {
+  try {
+    graph.run(threadCount);
+  } catch (const std::exception& error) {
+    return error.what();
+  }
+
+  return "";
+}
+
+// the committed SPIR-V declares the constant ids main.cpp specializes
+static void checkReflection() {
+  ShaderReflection vert = reflectSpirv(loadSpirv("shaders/vert.spv", true));
+  ShaderReflection frag = reflectSpirv(loadSpirv("shaders/frag.spv", true));
+
+  CHECK(vert.stage == VK_SHADER_STAGE_VERTEX_BIT);
+  CHECK(frag.stage == VK_SHADER_STAGE_FRAGMENT_BIT);
+  CHECK(vert.specConstantIds == std::set<uint32_t>({SPEC_TRIANGLE_SCALE}));
+  CHECK(frag.specConstantIds == std::set<uint32_t>({SPEC_COLOR_R, SPEC_COLOR_G, SPEC_COLOR_B}));
+
+  // positions come from gl_VertexIndex, nothing is fed by vertex buffers
+  CHECK(vert.vertexAttributes.empty());
+  CHECK(vert.vertexStride == 0);
+
+  ShaderReflection merged = mergeReflections({vert, frag});
+  CHECK(merged.stage == (VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT));
+  CHECK(merged.specConstantIds == std::set<uint32_t>({0, 1, 2, 3}));
+  CHECK(merged.descriptorSets.empty());
+  CHECK(merged.pushConstantSize == 0);
+}
+
+// equal descriptions share a variant, any differing field gets its own
+static void checkPipelineDescHashing() {
+  GraphicsPipelineDesc desc;
+  desc.vertShaderPath = "shaders/vert.spv";
+  desc.fragShaderPath = "shaders/frag.spv";
+  desc.vertSpecialization = {specializeFloat(SPEC_TRIANGLE_SCALE, 1.0f)};
+  desc.fragSpecialization = {
+    specializeFloat(SPEC_COLOR_R, 1.0f),
+    specializeFloat(SPEC_COLOR_G, 0.0f),
+    specializeFloat(SPEC_COLOR_B, 0.0f)
+  };
+  desc.dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+  desc.colorFormat = VK_FORMAT_B8G8R8A8_SRGB;
+  desc.rehash();
+
+  GraphicsPipelineDesc same = desc;
+  same.rehash();
+  CHECK(same == desc);
+  CHECK(same.hash == desc.hash);
+
+  GraphicsPipelineDesc scaled = desc;
+  scaled.vertSpecialization[0] = specializeFloat(SPEC_TRIANGLE_SCALE, 0.5f);
+  scaled.rehash();
+  CHECK(!(scaled == desc));
+  CHECK(scaled.hash != desc.hash);
+
+  GraphicsPipelineDesc culled = desc;
+  culled.cullMode = VK_CULL_MODE_NONE;
+  culled.rehash();
+  CHECK(!(culled == desc));
+  CHECK(culled.hash != desc.hash);
+
+  // a longer list is not equal to its prefix
+  GraphicsPipelineDesc moreStates = desc;
+  moreStates.dynamicStates.push_back(VK_DYNAMIC_STATE_LINE_WIDTH);
+  moreStates.rehash();
+  CHECK(!(moreStates == desc));
+
+  std::unordered_map<GraphicsPipelineDesc, int, GraphicsPipelineDescHash> variants;
+  variants.emplace(desc, 1);
+  variants.emplace(scaled, 2);
+  variants.emplace(same, 3);
+  CHECK(variants.size() == 2);
+  CHECK(variants.at(same) == 1);
+  CHECK(variants.at(scaled) == 2);
+}
+
+// dependencies must be added first, and run() honours them on any
+// number of threads
+static void checkInitGraphOrdering() {
+  InitGraph badOrder;
+  badOrder.add("create_swapchain", {"create_surface"}, []() {});
+  badOrder.add("create_surface", {}, []() {});
+  CHECK(runGraph(badOrder, 0).starts_with("ERROR_INIT_DEPENDENCY_ORDER"));
+
+  InitGraph unknown;
+  unknown.add("create_swapchain", {"create_surface"}, []() {});
+  CHECK(runGraph(unknown, 0).starts_with("ERROR_UNKNOWN_INIT_DEPENDENCY"));
+
+  for (uint32_t threadCount : {0u, 3u}) {
+    InitGraph graph;
+    std::mutex mutex;
+    std::vector<std::string> order;
+    std::thread::id callerThread = std::this_thread::get_id();
+    std::thread::id onCallerThread;
+
+    auto record = [&mutex, &order](const std::string& name) {
+      std::lock_guard<std::mutex> lock(mutex);
+      order.push_back(name);
+    };
+
+    graph.add("a", {}, [&record]() { record("a"); });
+    graph.add("b", {"a"}, [&record]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      record("b");
+    });
+    graph.add("c", {"a"}, [&record, &onCallerThread]() {
+      onCallerThread = std::this_thread::get_id();
+      record("c");
+    }, true);
+    graph.add("d", {"b", "c"}, [&record]() { record("d"); });
+
+    CHECK(runGraph(graph, threadCount).empty());
+    CHECK(order.size() == 4);
+    CHECK(order.front() == "a");
+    CHECK(order.back() == "d");
+    CHECK(onCallerThread == callerThread);
+  }
+
+  // a failing step stops its dependents from starting
+  InitGraph failing;
+  bool dependentRan = false;
+  failing.add("a", {}, []() { throw std::runtime_error("ERROR_STEP_FAILED"); });
+  failing.add("b", {"a"}, [&dependentRan]() { dependentRan = true; });
+  CHECK(runGraph(failing, 2) == "ERROR_STEP_FAILED");
+  CHECK(!dependentRan);
+}
+
+int main() {
+  checkReflection();
+  checkPipelineDescHashing();
+  checkInitGraphOrdering();
+
+  std::cout << "CHECKS: " << (failures == 0 ? "passed" : "failed") << '\n';
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}